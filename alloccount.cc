@@ -0,0 +1,91 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Global operator new/delete replacements that count calls per thread. Link
+// into a diagnostic build only; the counting itself is a thread-local
+// increment and does not change where memory comes from.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "alloccount.h"
+
+static thread_local AllocationCount counts;
+
+AllocationCount allocation_count()
+{
+    return counts;
+}
+
+static void* allocate(std::size_t size, std::size_t align)
+{
+    counts.news++;
+    if(size == 0) size = 1;
+    return align > alignof(std::max_align_t)
+        ? std::aligned_alloc(align, (size + align - 1) / align * align)
+        : std::malloc(size);
+}
+
+static void release(void* p)
+{
+    if(!p) return;
+    counts.deletes++;
+    std::free(p);
+}
+
+void* operator new(std::size_t size)
+{
+    if(void* p = allocate(size, 0)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    if(void* p = allocate(size, std::size_t(align))) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align)
+{
+    return operator new(size, align);
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { release(p); }
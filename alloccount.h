@@ -0,0 +1,30 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_ALLOCCOUNT_H
+#define CPPREADY_TRADER_GO_ALLOCCOUNT_H
+
+// Heap traffic of the calling thread, counted by the global operator
+// new/delete replacements in alloccount.cc. Only meaningful in a binary
+// linked with that file and built with AUTOTRADER_COUNT_ALLOCATIONS.
+struct AllocationCount {
+    unsigned long news = 0, deletes = 0;
+};
+
+AllocationCount allocation_count();
+
+#endif //CPPREADY_TRADER_GO_ALLOCCOUNT_H
@@ -17,10 +17,12 @@
 //     <https://www.gnu.org/licenses/>.
 #include <array>
 #include <algorithm>
+#include <cstdlib>
 #include<chrono> 
-#include <thread> 
 #include <iostream>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/system/error_code.hpp>
 
 #include <ready_trader_go/logging.h>
 
@@ -37,347 +39,874 @@ constexpr int POSITION_LIMIT = 100;
 constexpr int TICK_SIZE_IN_CENTS = 100;
 constexpr int MIN_BID_NEAREST_TICK = (MINIMUM_BID + TICK_SIZE_IN_CENTS) / TICK_SIZE_IN_CENTS * TICK_SIZE_IN_CENTS;
 constexpr int MAX_ASK_NEAREST_TICK = (MAXIMUM_ASK - TICK_SIZE_IN_CENTS) / TICK_SIZE_IN_CENTS * TICK_SIZE_IN_CENTS;
-const int MARGIN = 240;
 typedef long long ll;
 
-int r100(int x){
-    return ((x+50)/100)*100;
+// Attributes sends to the outermost decision path that is running.
+struct TraceScope {
+    TracePath& path;
+    bool owner;
+    TraceScope(TracePath& p, TracePath v) : path(p), owner(p == TracePath::NONE) { if(owner) path = v; }
+    ~TraceScope() { if(owner) path = TracePath::NONE; }
+};
+
+TraceSource trace_source(Instrument instrument){
+    return instrument == Instrument::FUTURE ? TraceSource::FUTURE : TraceSource::ETF;
 }
 
-void AutoTrader::cancellation_loop(){
-    auto target = std::chrono::high_resolution_clock::now();
-    while (1) {
-        if(limiter.check_remaining() < 15) {
-            std::this_thread::sleep_for(chrono::microseconds(21000 / SPEED));
-            continue;
-        }
-        if (last_future_info < std::chrono::high_resolution_clock::now() - chrono::microseconds(20000 / SPEED)){
-            if(!start) continue;
-            //RLOG(LG_AT, LogLevel::LL_INFO) << "Plan to get info" ;
-            cc^=1;
-            const std::lock_guard<std::mutex> lock(mtx);
-            int id = mNextMessageId++;
-            if(current_hedge == 100 && cc == 0) continue;
-            if(current_hedge == -100 && cc == 1) continue;
-            if(cc){
-                rate_limited_hedge(id, Side::SELL, r100(theo_fut + 100), 1);
-                hedgeS.insert(id);
-            } else {
-                rate_limited_hedge(id, Side::BUY, r100(theo_fut - 100), 1);
-                hedgeB.insert(id);
-            }
+// Runs on the same io_context as the message handlers, so it never races them.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::cancellation_loop(){
+    long long period = 21000000LL / params.speed;
+    timer_deadline = clock.now() + period;
+    ctimer->expires_after(period, [this]{
+        timer_late.record(uint64_t(std::max(0LL, clock.now() - timer_deadline)));
+        if(tracer) tracer->entry(TraceSource::TIMER);
+        if(profiler) profiler->begin(PerfCallback::TIMER);
+        for(size_t p=0;p<Pairs;p++){
+            send_pending(p);
+            probe_future(p);
         }
-        std::this_thread::sleep_for(chrono::microseconds(21000 / SPEED));
-    }
+        if(journal && journal->pending()) write_checkpoint();
+        end_callback();
+        cancellation_loop();
+    });
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::probe_future(size_t p){
+    TraceScope scope(trace_path, TracePath::PROBE_FUTURE);
+    if(!start[p]) return;
+    long long now = clock.now();
+    bool quiet = last_future_info[p] < now - 20000000LL / params.speed;
+    probe_stats.fixed += quiet;
+    if(params.probe_uncertainty ? !fut_estimator[p].uncertain(now, params.probe_uncertainty) : !quiet) return;
+    probe_stats.wanted++;
+
+    //RLOG(LG_AT, LogLevel::LL_INFO) << "Plan to get info" ;
+    cc[p]^=1;
+    // A full hedge can only be probed from the other side.
+    if(current_hedge[p] == 100 && cc[p] == 0) cc[p] = 1;
+    if(current_hedge[p] == -100 && cc[p] == 1) cc[p] = 0;
+    if(cc[p]) submit_hedge(p, Priority::PROBE, Side::SELL, round_to_tick(theo_fut[p] + FutureEstimator::PROBE_OFFSET), 1);
+    else submit_hedge(p, Priority::PROBE, Side::BUY, round_to_tick(theo_fut[p] - FutureEstimator::PROBE_OFFSET), 1);
+}
+
+// Sends are journaled before they go out, so a restart never reuses an id.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::send_cancel(unsigned long clientOrderId){
+    if(journal) journal_event(JournalType::CANCEL, clientOrderId, Side::SELL);
+    if(tracer) tracer->send(trace_path, TraceMessage::CANCEL, clientOrderId);
+    if(sink) sink->cancel(clientOrderId);
+    else SendCancelOrder(clientOrderId);
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::send_hedge(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume){
+    if(journal) journal_event(JournalType::HEDGE, clientOrderId, side, price, volume);
+    if(tracer) tracer->send(trace_path, TraceMessage::HEDGE, clientOrderId);
+    if(sink) sink->hedge(clientOrderId, side, price, volume);
+    else SendHedgeOrder(clientOrderId, side, price, volume);
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::send_insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan lifespan){
+    if(journal) journal_event(JournalType::INSERT, clientOrderId, side, price, volume);
+    if(tracer) tracer->send(trace_path, TraceMessage::INSERT, clientOrderId);
+    if(sink) sink->insert(clientOrderId, side, price, volume, lifespan);
+    else SendInsertOrder(clientOrderId, side, price, volume, lifespan);
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::submit_cancel(size_t p, Side side, unsigned long clientOrderId){
+    scheduler.queue_cancel(p, side, clientOrderId);
+    send_pending(p);
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::submit_hedge(size_t p, Priority priority, Side side, unsigned long price, unsigned long volume){
+    scheduler.queue_hedge(p, priority, side, price, volume);
+    send_pending(p);
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::submit_insert(size_t p, Side side, unsigned long price, unsigned long volume){
+    scheduler.queue_insert(p, side, price, volume);
+    send_pending(p);
 }
 
-bool AutoTrader::rate_limited_cancel(unsigned long clientOrderId){
-    if (limiter.check_and_add()){
-        SendCancelOrder(clientOrderId);
+template<class Policies, size_t Pairs>
+bool BasicAutoTrader<Policies, Pairs>::send_pending_hedge(size_t p, PendingOrder& hedge, Priority priority){
+    if(!hedge.active || future_l[p]) return true;
+    if(!trackable(mNextMessageId)){
+        scheduler.drop(hedge, priority);
         return true;
     }
+    if(!scheduler.admit(priority, hedge)) return false;
+
+    hedge.active = false;
+    int id = mNextMessageId++;
+    future_l[p] = true;
+    send_hedge(id, hedge.side, hedge.price, hedge.volume);
+    live.add(id, hedge.side, OrderKind::HEDGE, uint16_t(p));
+    return true;
+}
+
+// An order the table cannot take would go out untracked, and its fills and
+// statuses would be dropped as unknown, so it is not sent. The id is
+// skipped in case it was the clash.
+template<class Policies, size_t Pairs>
+bool BasicAutoTrader<Policies, Pairs>::trackable(unsigned long clientOrderId){
+    if(live.can_add(clientOrderId)) return true;
+    RLOG(LG_AT, LogLevel::LL_ERROR) << "not sending order " << clientOrderId << ": "
+                                    << (live.find(clientOrderId) ? "its id is in use" : "the order table is full");
+    mNextMessageId = clientOrderId + 1;
     return false;
 }
 
-bool AutoTrader::rate_limited_hedge(unsigned long clientOrderId,  Side side, unsigned long price, unsigned long volume){
-    if(future_l) return false;
+// Sends whatever is pending for the pair, highest class first, until the
+// budget runs out. Once a class is denied every lower class would be too, so
+// stop there.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::send_pending(size_t p){
+    for(auto& c: scheduler.cancels[p]){
+        if(!c.active) continue;
+        OrderEntry* e = live.find(c.id);
+        if(!e || e->state != OrderState::LIVE){
+            c.active = false;
+            continue;
+        }
+        if(!scheduler.admit(Priority::CANCEL, c)) return;
+        c.active = false;
+        send_cancel(c.id);
+        cancelled(c.side == Side::SELL ? asks[p] : bids[p], c.id);
+    }
 
-    if (limiter.check_and_add()){
-        future_l = true;
-        SendHedgeOrder(clientOrderId, side, price, volume);
-        return true;
+    if(!send_pending_hedge(p, scheduler.hedge[p], Priority::HEDGE)) return;
+
+    for(auto& q: scheduler.inserts[p]){
+        if(!q.active) continue;
+        orders& ladder = q.side == Side::SELL ? asks[p] : bids[p];
+        if(ladder.cnt() == 2 || ladder.contains_price(q.price)){
+            q.active = false;
+            continue;
+        }
+        if(!trackable(mNextMessageId)){
+            scheduler.drop(q, Priority::QUOTE);
+            continue;
+        }
+        if(!scheduler.admit(Priority::QUOTE, q)) return;
+        q.active = false;
+        send_insert(mNextMessageId, q.side, q.price, q.volume, Lifespan::GOOD_FOR_DAY);
+        ladder.insert(mNextMessageId, q.price, q.volume);
+        live.add(mNextMessageId, q.side, OrderKind::QUOTE, uint16_t(p));
+        mNextMessageId+=1;
     }
-    return false;
+
+    send_pending_hedge(p, scheduler.probe[p], Priority::PROBE);
 }
 
-bool AutoTrader::rate_limited_insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan lifespan){
-    if (limiter.check_and_add()){
-        SendInsertOrder(clientOrderId, side, price, volume, lifespan);
-        return true;
+TraderOptions TraderOptions::from_environment()
+{
+    TraderOptions o;
+    const char* names[] = {"AUTOTRADER_RECORD", "AUTOTRADER_TRACE", "AUTOTRADER_LOG", "AUTOTRADER_MONITOR",
+                           "AUTOTRADER_JOURNAL", "AUTOTRADER_PERF", "AUTOTRADER_LOW_LATENCY"};
+    std::string* fields[] = {&o.record, &o.trace, &o.log, &o.monitor, &o.journal, &o.perf, &o.low_latency};
+    for(size_t i=0;i<sizeof(names)/sizeof(names[0]);i++)
+        if(const char* value = std::getenv(names[i])) *fields[i] = value;
+    return o;
+}
+
+template<class Policies, size_t Pairs>
+BasicAutoTrader<Policies, Pairs>::BasicAutoTrader(boost::asio::io_context& context)
+    : BasicAutoTrader(context, StrategyParams(), nullptr, TraderOptions::from_environment())
+{
+}
+
+template<class Policies, size_t Pairs>
+BasicAutoTrader<Policies, Pairs>::BasicAutoTrader(boost::asio::io_context& context, const StrategyParams& params, Clock* clock,
+                                           const TraderOptions& options)
+    : BaseAutoTrader(context), context(context), clock(clock ? *clock : real_clock()),
+      ctimer(this->clock.make_timer(context)), params(params)
+{
+    fut_estimator.fill(FutureEstimator(1000000LL * params.speed));
+    theo_fut.fill(-1);
+    theo_etf.fill(-1);
+    theo.fill(-1);
+    last_future_info.fill(this->clock.now());
+
+    if(!options.record.empty()) record_session(options.record.c_str());
+    if(!options.trace.empty()) tracer.reset(new LatencyTracer(options.trace));
+    if(!options.log.empty()) binlog.reset(new BinaryLogger(options.log.c_str()));
+    if(!options.monitor.empty()) {
+        monitor.reset(new StateMonitor(options.monitor.c_str()));
+        if(!monitor->ok()) {
+            RLOG(LG_AT, LogLevel::LL_ERROR) << "could not map shared memory " << options.monitor;
+            monitor.reset();
+        }
     }
-    return false;
+    // The journal and the monitor follow pair 0; a checkpoint holds one
+    // pair's orders.
+    if(!options.journal.empty() && Pairs > 1)
+        RLOG(LG_AT, LogLevel::LL_ERROR) << "the order journal covers a single pair, not opening " << options.journal;
+    else if(!options.journal.empty()) open_journal(options.journal.c_str());
+    if(!options.perf.empty()) {
+        profiler.reset(new CallbackProfiler(options.perf));
+        if(!profiler->ok()) {
+            RLOG(LG_AT, LogLevel::LL_ERROR) << "could not open performance counters or " << options.perf;
+            profiler.reset();
+        }
+        else if(profiler->available() != (1u << PERF_COUNTERS) - 1)
+            RLOG(LG_AT, LogLevel::LL_WARNING) << "some performance counters are unavailable (see perfreport)";
+    }
+    // Last, so the threads started above can be kept off the trading CPU.
+    if(!options.low_latency.empty()) enable_low_latency(options.low_latency.c_str());
+    cancellation_loop();
+}
+
+// Runs on the thread that goes on to run the io_context.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::enable_low_latency(const char* spec)
+{
+    LowLatencyConfig config;
+    std::string bad;
+    if(!config.parse(spec, bad)){
+        RLOG(LG_AT, LogLevel::LL_ERROR) << "bad AUTOTRADER_LOW_LATENCY item '" << bad << "'";
+        return;
+    }
+
+    pthread_t self = pthread_self();
+    if(config.cpu >= 0 && !pin_thread(self, config.cpu))
+        RLOG(LG_AT, LogLevel::LL_WARNING) << "could not pin the trading thread to cpu " << config.cpu;
+    cpu_set_t aux = config.aux_cpus();
+    if(tracer && tracer->worker().joinable()) pin_thread(tracer->worker().native_handle(), aux);
+    if(binlog && binlog->worker().joinable()) pin_thread(binlog->worker().native_handle(), aux);
+    if(profiler && profiler->worker().joinable()) pin_thread(profiler->worker().native_handle(), aux);
+
+    if(config.mlock && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        RLOG(LG_AT, LogLevel::LL_WARNING) << "mlockall failed";
+    if(config.mlock || config.prefault_mb) prefault(config.prefault_mb);
+    // A spinning SCHED_FIFO thread starves everything else on its CPU, so
+    // only ask for it on an isolated one, and never when there is no other.
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    if(config.fifo > 0 && CPU_COUNT(&allowed) < 2)
+        RLOG(LG_AT, LogLevel::LL_WARNING) << "not using SCHED_FIFO with a single CPU available";
+    else if(config.fifo > 0 && !set_fifo(self, config.fifo))
+        RLOG(LG_AT, LogLevel::LL_WARNING) << "could not set SCHED_FIFO priority " << config.fifo;
+
+    ticks_per_ns = tsc_calibrate();
+    spinning = true;
+    boost::asio::post(context, [this]{ busy_poll(); });
+    RLOG(LG_AT, LogLevel::LL_INFO) << "busy polling" << (config.cpu >= 0 ? " on cpu " + std::to_string(config.cpu) : "");
 }
 
-AutoTrader::AutoTrader(boost::asio::io_context& context) : BaseAutoTrader(context)
+// Takes the io_context's thread over from run(): rather than sleeping in
+// epoll until something arrives, poll() is called back to back. asio allows
+// poll() to nest inside a handler, and the loop gives the thread back to
+// run() once the exchange connection is lost.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::busy_poll()
 {
-   cloop = thread(&AutoTrader::cancellation_loop, this);
+    uint64_t last = tsc_now();
+    while(spinning && !context.stopped()){
+        size_t handled = context.poll();
+        uint64_t now = tsc_now();
+        if(!handled) poll_gap.record(uint64_t((now - last) / ticks_per_ns));
+        last = now;
+    }
+}
+
+template<class Policies, size_t Pairs>
+bool BasicAutoTrader<Policies, Pairs>::record_session(const char* path)
+{
+    recorder.reset(new SessionRecorder(path));
+    if(!recorder->ok()){
+        RLOG(LG_AT, LogLevel::LL_ERROR) << "could not open session file " << path;
+        recorder.reset();
+        return false;
+    }
+    return true;
 }
 
-void AutoTrader::DisconnectHandler()
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::DisconnectHandler()
 {
     BaseAutoTrader::DisconnectHandler();
+    ctimer->cancel();
+    spinning = false;
+    // The session is over; a new one must not pick up its orders.
+    if(journal) write_checkpoint(true);
     RLOG(LG_AT, LogLevel::LL_INFO) << "execution connection lost";
+
+    RLOG(LG_AT, LogLevel::LL_INFO) << "timer wake-up lateness: p50 " << timer_late.percentile(0.5) << " ns, p99 "
+                                   << timer_late.percentile(0.99) << " ns, max " << timer_late.max() << " ns";
+    if(poll_gap.count())
+        RLOG(LG_AT, LogLevel::LL_INFO) << "idle poll gap over " << poll_gap.count() << " polls: p50 " << poll_gap.percentile(0.5)
+                                       << " ns, p99 " << poll_gap.percentile(0.99) << " ns, max " << poll_gap.max() << " ns";
+
+    ConflationStats md;
+    for(const MarketDataConflator& c: conflator){
+        md.books += c.stats.books;
+        md.ticks += c.stats.ticks;
+        md.conflated += c.stats.conflated;
+        md.stale += c.stats.stale;
+        md.gaps += c.stats.gaps;
+    }
+    RLOG(LG_AT, LogLevel::LL_INFO) << "market data: " << md.books << " books, " << md.ticks << " trade ticks, "
+                                   << md.conflated << " conflated, " << md.stale << " stale, " << md.gaps << " missed";
+
+    static const char* classes[] = {"cancel", "hedge", "quote", "probe"};
+    for(size_t p=0;p<size_t(Priority::COUNT);p++){
+        const BudgetStats& b = scheduler.stats_for(Priority(p));
+        RLOG(LG_AT, LogLevel::LL_INFO) << "message budget " << classes[p] << ": sent " << b.sent
+                                       << ", denied " << b.denied << ", superseded " << b.superseded;
+    }
+    RLOG(LG_AT, LogLevel::LL_INFO) << "future probes: wanted " << probe_stats.wanted << ", the 20ms rule would have wanted "
+                                   << probe_stats.fixed << ", saving " << (long)(probe_stats.fixed - probe_stats.wanted);
 }
 
-void AutoTrader::ErrorMessageHandler(unsigned long clientOrderId,
-                                     const std::string& errorMessage)
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::ErrorMessageHandler(unsigned long clientOrderId,
+                                                    const std::string& errorMessage)
 {
     RLOG(LG_AT, LogLevel::LL_INFO) << "error with order " << clientOrderId << ": " << errorMessage;
 }
 
 
 
-void AutoTrader::test_place_order(){
-    if(newAskPrice <= newBidPrice) return;
-    if(limiter.check_remaining() < 2) return;
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::test_place_order(size_t p){
+    TraceScope scope(trace_path, TracePath::TEST_PLACE_ORDER);
+    if(newAskPrice[p] <= newBidPrice[p]) return;
+    int position = mPosition[p];
 
-    int ask_target = (mPosition + POSITION_LIMIT + 1)/2;
+    int ask_target = (position + POSITION_LIMIT + 1)/2;
+    int ask = 0;
 
-    if (!(mPosition <= 0 && asks.cnt() != 0)){
-        if (mPosition <= 0 ) ask_target = 200;
-        if ( newAskPrice!=0 && asks.cnt() < 2 && (!asks.contains_price(newAskPrice)) ) {
-            int ask = min(ask_target, mPosition + POSITION_LIMIT - asks.totsz());
-            
-            if (ask && rate_limited_insert(mNextMessageId, Side::SELL, newAskPrice, ask, Lifespan::GOOD_FOR_DAY)) {
-                asks.insert(mNextMessageId, newAskPrice, ask);
-                mNextMessageId+=1;
-            }
+    if (!(position <= 0 && asks[p].cnt() != 0)){
+        if (position <= 0 ) ask_target = 200;
+        ask = min(ask_target, position + POSITION_LIMIT - asks[p].totsz());
+    }
 
-        }
+    if (newAskPrice[p] != 0) requote(p, asks[p], Side::SELL, Quote{(int)newAskPrice[p], ask});
+
+    int bid_target = (POSITION_LIMIT - position + 1)/2;
+    int bid = 0;
+
+    if(!(position>=0 && bids[p].cnt() != 0)){
+        if(position>=0) ask_target = 200;
+        bid = min(bid_target, POSITION_LIMIT-position - bids[p].totsz());
     }
 
-    int bid_target = (POSITION_LIMIT - mPosition + 1)/2;
+    if (newBidPrice[p] != 0) requote(p, bids[p], Side::BUY, Quote{(int)newBidPrice[p], bid});
+}
 
-    if(!(mPosition>=0 && bids.cnt() != 0)){
-        if(mPosition>=0) ask_target = 200;
-        if(newBidPrice !=0 && bids.cnt() < 2 && (!bids.contains_price(newBidPrice))) {
-            int bid = min(bid_target, POSITION_LIMIT-mPosition - bids.totsz());
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::requote(size_t p, orders& ladder, Side side, const Quote& want){
+    QuoteAction actions[4];
+    int n = ladder.diff(&want, 1, actions, 4);
 
-            if(bid && rate_limited_insert(mNextMessageId, Side::BUY, newBidPrice, bid, Lifespan::GOOD_FOR_DAY)) {
-                bids.insert(mNextMessageId, newBidPrice, bid);
-                mNextMessageId+=1;
-            }
-        }
+    scheduler.retarget(p, side, want.price);
+    for(int i=0;i<n;i++){
+        const QuoteAction& a = actions[i];
+        if(a.type == QuoteAction::CANCEL) submit_cancel(p, side, a.id);
+        else submit_insert(p, side, a.price, a.size);
     }
-    
 }
 
 
-double weight[5] = {0.35,0.25,0.15,0.10,0.05};
-double calc_vwap(const std::array<unsigned long, TOP_LEVEL_COUNT> Prices,
-                                         const std::array<unsigned long, TOP_LEVEL_COUNT> Volumes)
-{
-    double A = 0, B = 0;
-    for(int i=0;i<5;i++){
-        A += weight[i]*Prices[i]*Volumes[i];
-        B += weight[i]*Volumes[i];
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::try_hedge(size_t p){
+    TraceScope scope(trace_path, TracePath::TRY_HEDGE);
+
+    // With hedge_on_book, a hedge the last future book has nothing for at
+    // its price would only come back empty, so it waits for a book that does.
+    int price = Hedging::price(theo_fut[p]);
+    const LocalBook<>& future = books[p][size_t(Instrument::FUTURE)];
+    auto fillable = [&](Side resting){ return !params.hedge_on_book || future.volume_to(resting, price); };
+    if(target_hedge[p]<current_hedge[p] && fillable(Side::BUY)){
+        submit_hedge(p, Priority::HEDGE, Side::SELL, price, current_hedge[p]-target_hedge[p]);
+    } else if(target_hedge[p]>current_hedge[p] && fillable(Side::SELL)){
+        submit_hedge(p, Priority::HEDGE, Side::BUY, price, target_hedge[p] - current_hedge[p]);
+    } else {
+        scheduler.drop(scheduler.hedge[p], Priority::HEDGE);
     }
-    if(B < 1) return 0;
-    return A/B;
 }
 
-int get_h(int c){
-    return min(96, max(-96, -c));
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::cancelled(orders& side, int id){
+    side.cancel(id);
+    if(OrderEntry* e = live.find(id)) e->state = OrderState::CANCELLING;
 }
 
-void AutoTrader::try_hedge(){
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::cancel_and_place(size_t p){
+    TraceScope scope(trace_path, TracePath::CANCEL_AND_PLACE);
+    int ask, bid;
+    Quoting::prices(theo[p], mPosition[p], params.margin, ask, bid);
+    newAskPrice[p] = ask;
+    newBidPrice[p] = bid;
 
-    if(target_hedge<current_hedge){
-        int id = mNextMessageId++;
-        rate_limited_hedge(id, Side::SELL, ((theo_fut+50)/100)*100, current_hedge-target_hedge);
-        hedgeS.insert(id);
-    }
+    // Size 0: only pull the orders away from the new prices here, the
+    // replacements are placed by test_place_order.
+    if (ask != 0) requote(p, asks[p], Side::SELL, Quote{ask, 0});
+    if (bid != 0) requote(p, bids[p], Side::BUY, Quote{bid, 0});
+
+    if(start[p]) test_place_order(p);
+}
 
-    if(target_hedge>current_hedge){
-        int id = mNextMessageId++;
-        rate_limited_hedge(id, Side::BUY, ((theo_fut+50)/100)*100, target_hedge - current_hedge);
-        hedgeB.insert(id);
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::new_fut_price(size_t p, int maxask, int askvol, int minbid, int bidvol){
+    TraceScope scope(trace_path, TracePath::NEW_FUT_PRICE);
+    if(minbid == 1e9 && maxask == 0) return;
+    long long now = clock.now();
+    FutureEstimator& e = fut_estimator[p];
+    if(maxask == 0) e.at_most(minbid, now);
+    if(minbid == 1e9) e.at_least(maxask, now);
+    if(maxask != 0 && minbid != 1e9){
+        if (askvol > bidvol) e.at_least(maxask, now);
+        else e.at_most(minbid, now);
     }
+    theo_fut[p] = e.value();
+
+    last_future_info[p] = now;
+    update_theo(p);
+
+    cancel_and_place(p);
 }
 
-void AutoTrader::cancel_and_place(){
-    newAskPrice = r100(theo + MARGIN);
-    newBidPrice = r100(theo - MARGIN);
-    
-    if(mPosition < 0) newBidPrice+=100;
-    if(mPosition > 0) newAskPrice-=100;
+// Runs last in every callback that can send.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::end_callback(){
+    if(sink) sink->flush();
+    if(monitor) publish_state();
+    if(profiler) profiler->end();
+}
 
-    if (newAskPrice != 0) {
-        vector<int> atcs = asks.to_cancel_ne(newAskPrice);
-        for(auto atc: atcs){
-            if ( atc && rate_limited_cancel(atc) ) asks.cancel(atc);
-        }
+// A few dozen stores into the shared snapshot; see monitor.h. It shows
+// pair 0, the one the exchange handlers feed.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::publish_state(){
+    StrategySnapshot& s = monitor->begin();
+    s.time = clock.now();
+    s.position = mPosition[0];
+    s.current_hedge = current_hedge[0];
+    s.target_hedge = target_hedge[0];
+    s.theo = theo[0];
+    s.theo_fut = theo_fut[0];
+    s.theo_etf = theo_etf[0];
+    s.etf_ask = etfA[0];
+    s.etf_bid = etfB[0];
+    s.asks = asks[0].cnt();
+    s.bids = bids[0].cnt();
+    for(int i=0;i<MONITOR_LEVELS;i++){
+        Quote a = i < asks[0].cnt() ? asks[0].at(i) : Quote{0, 0};
+        Quote b = i < bids[0].cnt() ? bids[0].at(i) : Quote{0, 0};
+        s.ask[i] = MonitorLevel{a.price, a.size};
+        s.bid[i] = MonitorLevel{b.price, b.size};
     }
-
-    if (newBidPrice != 0) {
-        vector<int> atcs = bids.to_cancel_ne(newBidPrice);
-        for(auto atc: atcs){
-            if ( atc && rate_limited_cancel(atc) ) bids.cancel(atc);
-        }
+    s.window_free = limiter.check_remaining();
+    s.live_orders = int32_t(live.size());
+    s.hedge_in_flight = future_l[0];
+    s.started = start[0];
+    for(int p=0;p<MONITOR_CLASSES;p++){
+        const BudgetStats& b = scheduler.stats_for(Priority(p));
+        s.sent[p] = b.sent;
+        s.denied[p] = b.denied;
     }
+    s.etf_ofi = features[0].get()[Instrument::ETF].ofi;
+    s.basis = features[0].get().basis;
+    s.future_var = fut_estimator[0].variance(s.time);
+    s.probes_wanted = probe_stats.wanted;
+    s.probes_fixed = probe_stats.fixed;
+    monitor->commit();
+}
 
-    if(start) test_place_order();
+// The bookkeeping for execution reports, shared with journal recovery. A
+// report for an order we do not know is put down to pair 0.
+
+template<class Policies, size_t Pairs>
+size_t BasicAutoTrader<Policies, Pairs>::pair_of(unsigned long clientOrderId){
+    OrderEntry* e = live.find(clientOrderId);
+    return e ? e->pair : 0;
 }
 
-void AutoTrader::new_fut_price(int maxask, int askvol, int minbid, int bidvol){
-    if(minbid == 1e9 && maxask == 0) return;
-    if(maxask == 0) theo_fut = min(theo_fut, minbid);
-    if(minbid == 1e9) theo_fut = max(theo_fut, maxask);
-    if(maxask != 0 && minbid != 1e9){
-        if (askvol > bidvol) theo_fut = max(theo_fut, maxask);
-        else theo_fut = min(theo_fut, minbid);
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::book_order_fill(unsigned long clientOrderId, unsigned long volume){
+    OrderEntry* e = live.find(clientOrderId);
+    size_t p = e ? e->pair : 0;
+    if (e && e->kind == OrderKind::QUOTE) {
+        if (e->side == Side::SELL) mPosition[p] -= (long)volume;
+        else mPosition[p] += (long)volume;
     }
+    target_hedge[p] = Hedging::target(mPosition[p], current_hedge[p], params.hedge_cap);
+}
 
-    last_future_info = std::chrono::high_resolution_clock::now();
-    theo = (theo_fut*2 + theo_etf*2)/4;
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::book_order_status(unsigned long clientOrderId, unsigned long remainingVolume){
+    OrderEntry* e = live.find(clientOrderId);
+    if(e && e->kind == OrderKind::QUOTE){
+        if(e->side == Side::SELL) asks[e->pair].update(clientOrderId, remainingVolume);
+        else bids[e->pair].update(clientOrderId, remainingVolume);
+        if(remainingVolume == 0) live.erase(clientOrderId);
+    }
+}
 
-    cancel_and_place();
+// False if the fill is not for one of our hedges; otherwise side is the
+// hedge's side. p is the pair either way.
+template<class Policies, size_t Pairs>
+bool BasicAutoTrader<Policies, Pairs>::book_hedge_fill(unsigned long clientOrderId, unsigned long volume, Side& side, size_t& p){
+    OrderEntry* e = live.find(clientOrderId);
+    p = e ? e->pair : 0;
+    future_l[p] = 0;
+    if(!e || e->kind != OrderKind::HEDGE) return false;
+    side = e->side;
+    if(side == Side::SELL) current_hedge[p] -= (long)volume;
+    else current_hedge[p] += (long)volume;
+    // A hedge order gets exactly one fill report.
+    live.erase(clientOrderId);
+    return true;
 }
 
+// Records the event, checkpointing first in the rare case the ring is full.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::journal_event(JournalType type, unsigned long clientOrderId, Side side,
+                                              unsigned long price, unsigned long volume, unsigned long remaining){
+    long long now = clock.now();
+    if(journal->append(type, now, clientOrderId, uint8_t(side), price, volume, remaining)) return;
+    write_checkpoint();
+    journal->append(type, now, clientOrderId, uint8_t(side), price, volume, remaining);
+}
 
-void AutoTrader::HedgeFilledMessageHandler(unsigned long clientOrderId,
-                                           unsigned long price,
-                                           unsigned long volume)
-{
-    const std::lock_guard<std::mutex> lock(mtx);
-    
-    // RLOG(LG_AT, LogLevel::LL_INFO) << "hedge order " << clientOrderId << " filled for " << volume
-    //                                << " lots at $" << price << " average price in cents";
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::write_checkpoint(bool closed){
+    JournalCheckpoint& c = journal->checkpoint();
+    c.closed = closed;
+    c.time = clock.now();
+    c.next_id = mNextMessageId;
+    c.position = mPosition[0];
+    c.current_hedge = current_hedge[0];
+
+    long long sends[JOURNAL_SENDS];
+    c.sends = limiter.history(sends, JOURNAL_SENDS);
+    std::copy(sends, sends + c.sends, c.send_times);
+
+    int n = 0;
+    for(const orders* ladder: {&asks[0], &bids[0]}){
+        uint8_t side = uint8_t(ladder == &asks[0] ? Side::SELL : Side::BUY);
+        for(int i=0;i<ladder->cnt();i++){
+            const orders::Level& l = ladder->level(i);
+            c.order[n++] = JournalOrder{uint32_t(l.id), uint32_t(l.price), uint32_t(l.size), side, 0, uint8_t(l.cancelled), 0};
+        }
+    }
+    live.for_each([&](const OrderEntry& e){
+        if(e.kind == OrderKind::HEDGE && n < JOURNAL_ORDERS)
+            c.order[n++] = JournalOrder{uint32_t(e.id), 0, 0, uint8_t(e.side), 1, 0, 0};
+    });
+    c.orders = n;
+    journal->commit();
+}
 
-    int maxask = 0, askvol = 0, minbid = 1e9, bidvol = 0;
-    if (hedgeS.count(clientOrderId) == 1) {
-        current_hedge -= (long)volume;
-        maxask = price + 102;
-        askvol = 1;
-    } else if (hedgeB.count(clientOrderId) == 1) {
-        current_hedge += (long)volume;
-        minbid = price - 102;
-        bidvol = 1;
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::open_journal(const char* path){
+    journal.reset(new OrderJournal(path));
+    if(!journal->ok()){
+        RLOG(LG_AT, LogLevel::LL_ERROR) << "could not map journal " << path;
+        journal.reset();
+        return;
     }
 
-    future_l = 0;
+    auto started = std::chrono::steady_clock::now();
+    const JournalCheckpoint* c = journal->recovered();
+    if(c && !c->closed){
+        restore(*c);
+        for(const JournalRecord* r = journal->begin(); r != journal->end(); ++r) recover(*r);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+        RLOG(LG_AT, LogLevel::LL_INFO) << "recovered position " << mPosition[0] << ", hedge " << current_hedge[0] << ", "
+                                       << live.size() << " live orders and next order id " << mNextMessageId << " from "
+                                       << journal->pending() << " journal records in " << us << " us";
+    }
+    // Start the new process's log from a clean checkpoint.
+    write_checkpoint();
+    if(monitor) publish_state();
+}
 
-    if(volume == 1){
-        new_fut_price(maxask, askvol, minbid, bidvol);
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::restore(const JournalCheckpoint& c){
+    mNextMessageId = c.next_id;
+    mPosition[0] = c.position;
+    current_hedge[0] = c.current_hedge;
+    target_hedge[0] = Hedging::target(mPosition[0], current_hedge[0], params.hedge_cap);
+    for(uint32_t i=0;i<c.sends && i<uint32_t(JOURNAL_SENDS);i++) limiter.restore(c.send_times[i]);
+
+    for(uint32_t i=0;i<c.orders && i<uint32_t(JOURNAL_ORDERS);i++){
+        const JournalOrder& o = c.order[i];
+        Side side = Side(o.side);
+        if(!live.add(o.clientOrderId, side, o.hedge ? OrderKind::HEDGE : OrderKind::QUOTE)){
+            RLOG(LG_AT, LogLevel::LL_ERROR) << "journal checkpoint order " << o.clientOrderId << " cannot be tracked";
+            continue;
+        }
+        if(o.hedge){
+            future_l[0] = 1;
+            continue;
+        }
+        orders& ladder = side == Side::SELL ? asks[0] : bids[0];
+        ladder.insert(o.clientOrderId, o.price, o.volume);
+        if(o.cancelling) cancelled(ladder, o.clientOrderId);
     }
+}
 
+// Applies one journaled event on top of the restored checkpoint, the way
+// send_pending() and the execution handlers did when it happened.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::recover(const JournalRecord& r){
+    Side side = Side(r.side);
+    switch(r.kind()){
+    case JournalType::INSERT:
+        if(live.add(r.clientOrderId, side, OrderKind::QUOTE)) (side == Side::SELL ? asks[0] : bids[0]).insert(r.clientOrderId, r.price, r.volume);
+        else RLOG(LG_AT, LogLevel::LL_ERROR) << "journalled order " << r.clientOrderId << " cannot be tracked";
+        break;
+    case JournalType::CANCEL:
+        if(OrderEntry* e = live.find(r.clientOrderId)) cancelled(e->side == Side::SELL ? asks[0] : bids[0], r.clientOrderId);
+        break;
+    case JournalType::HEDGE:
+        if(live.add(r.clientOrderId, side, OrderKind::HEDGE)) future_l[0] = 1;
+        else RLOG(LG_AT, LogLevel::LL_ERROR) << "journalled hedge " << r.clientOrderId << " cannot be tracked";
+        break;
+    case JournalType::ORDER_FILLED:
+        book_order_fill(r.clientOrderId, r.volume);
+        return;
+    case JournalType::ORDER_STATUS:
+        book_order_status(r.clientOrderId, r.remaining);
+        return;
+    case JournalType::HEDGE_FILLED: {
+        size_t p;
+        book_hedge_fill(r.clientOrderId, r.volume, side, p);
+        return;
+    }
+    }
+    // A send: it took a message from the window and used up an id.
+    limiter.restore(r.time);
+    mNextMessageId = std::max(mNextMessageId, (unsigned long)r.clientOrderId + 1);
 }
 
+// Even blend of the future and ETF values, leaning towards the side the
+// ETF order flow is pushing.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::update_theo(size_t p){
+    theo[p] = (theo_fut[p]*2 + theo_etf[p]*2)/4;
+    if(params.flow_skew) theo[p] += int(params.flow_skew * features[p].get()[Instrument::ETF].ofi / 100);
+    if(tracer) tracer->theo();
+}
 
-void AutoTrader::OrderBookMessageHandler(Instrument instrument,
-                                         unsigned long sequenceNumber,
-                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
-                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& askVolumes,
-                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
-                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
-{
-    const std::lock_guard<std::mutex> lock(mtx);
-    
-    // RLOG(LG_AT, LogLevel::LL_INFO) << "order book received for " << instrument << " instrument"
-    //                                << ": ask prices: " << askPrices[0]
-    //                                << "; ask volumes: " << askVolumes[0]
-    //                                << "; bid prices: " << bidPrices[0]
-    //                                << "; bid volumes: " << bidVolumes[0];
 
-    
-    
+// The strategy runs from a posted handler, so every market data message
+// that is already queued on the io_context is folded in before it acts.
+// One handler serves every pair that has news, in the order it came.
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::schedule_market_data(size_t p){
+    if(!md_queued[p]){
+        md_queued[p] = true;
+        md_queue[md_waiting++] = uint16_t(p);
+    }
+    if(md_scheduled) return;
+    md_scheduled = true;
+    boost::asio::post(context, allocated_handler(md_memory, [this]{
+        md_scheduled = false;
+        process_market_data();
+    }));
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::process_market_data(){
+    if(tracer) tracer->batch();
+    if(profiler) profiler->begin(PerfCallback::MARKET_DATA);
+    for(size_t i=0;i<md_waiting;i++){
+        size_t p = md_queue[i];
+        md_queued[p] = false;
+        process_market_data(p);
+    }
+    md_waiting = 0;
+    end_callback();
+}
 
-    if (instrument == Instrument::FUTURE) {
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::process_market_data(size_t p){
+    MarketDataConflator& conflator = this->conflator[p];
+    if (const BookSnapshot* b = conflator.take_book(Instrument::FUTURE)) {
         //int theo = (1ll*askPrices[0]*askVolumes[0] + 1ll*bidPrices[0]*bidVolumes[0])/(askVolumes[0] + bidVolumes[0]);
-        theo_fut = (calc_vwap(askPrices,askVolumes) + calc_vwap(bidPrices,bidVolumes))/2;
-        last_future_info = std::chrono::high_resolution_clock::now();
+        last_future_info[p] = clock.now();
+        fut_estimator[p].book(Pricing::future(*b), last_future_info[p]);
+        theo_fut[p] = fut_estimator[p].value();
         //int theo = (1ll*askPrices[0] + 1ll*bidPrices[0])/2;
     }
-    
-    if (instrument == Instrument::ETF) {
-        std::array<unsigned long, TOP_LEVEL_COUNT> aV = askVolumes;
-        std::array<unsigned long, TOP_LEVEL_COUNT> bV = bidVolumes;
-        
-        for(int i=0;i<5;i++)aV[i] = min(250,(int)aV[i]);
-        for(int i=0;i<5;i++)bV[i] = min(250,(int)bV[i]);
-        etfA = calc_vwap(askPrices,aV);
-        etfB = calc_vwap(bidPrices,bV);
 
-        theo_etf = (etfA+etfB)/2;
-        theo = (theo_fut*2 + theo_etf*2)/4;
+    TickSummary t;
+    if (conflator.take_ticks(Instrument::FUTURE, t)) {
+        new_fut_price(p, t.maxask, t.askvol, t.minbid, t.bidvol);
+    }
+
+    if (const BookSnapshot* b = conflator.take_book(Instrument::ETF)) {
+        Pricing::etf(*b, params.etf_clamp, etfA[p], etfB[p]);
+
+        theo_etf[p] = (etfA[p]+etfB[p])/2;
+        update_theo(p);
         
-        if(sequenceNumber > 5){
-            start = 1;
+        if(b->sequence > 5){
+            start[p] = 1;
         }
         
-        cancel_and_place();
-        try_hedge();
+        cancel_and_place(p);
+        try_hedge(p);
     }
 }
 
 
-void AutoTrader::OrderFilledMessageHandler(unsigned long clientOrderId,
-                                           unsigned long price,
-                                           unsigned long volume)
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::HedgeFilledMessageHandler(unsigned long clientOrderId,
+                                                          unsigned long price,
+                                                          unsigned long volume)
 {
-    const std::lock_guard<std::mutex> lock(mtx);
-    
-    // RLOG(LG_AT, LogLevel::LL_INFO) << "order " << clientOrderId << " filled for " << volume
-    //                                << " lots at $" << price << " cents";
-    
-    if (asks.contains(clientOrderId)) {
-        mPosition -= (long)volume;
+    if(tracer) tracer->entry(TraceSource::EXECUTION);
+    if(profiler) profiler->begin(PerfCallback::HEDGE_FILLED);
+    if(recorder) recorder->fill(RecordType::HEDGE_FILLED, clientOrderId, price, volume);
+
+    if(binlog) binlog->log(LogFormat::HEDGE_FILLED, clientOrderId, volume, price);
+
+    if(journal) journal_event(JournalType::HEDGE_FILLED, clientOrderId, Side::SELL, price, volume);
+
+    int maxask = 0, askvol = 0, minbid = 1e9, bidvol = 0;
+    Side side;
+    size_t p;
+    if (book_hedge_fill(clientOrderId, volume, side, p)) {
+        if (side == Side::SELL) {
+            maxask = price + params.hedge_fill_offset;
+            askvol = 1;
+        } else {
+            minbid = price - params.hedge_fill_offset;
+            bidvol = 1;
+        }
+        // One that found nothing to trade with still says where the future is not.
+        if (volume == 0) fut_estimator[p].missed(clock.now());
     }
-    
-    if (bids.contains(clientOrderId)) {
-        mPosition += (long)volume;
+
+    send_pending(p);
+
+    if(volume == 1){
+        new_fut_price(p, maxask, askvol, minbid, bidvol);
     }
+    end_callback();
+}
+
 
-    target_hedge = get_h(mPosition);
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::OrderBookMessageHandler(Instrument instrument,
+                                                        unsigned long sequenceNumber,
+                                                        const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
+                                                        const std::array<unsigned long, TOP_LEVEL_COUNT>& askVolumes,
+                                                        const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
+                                                        const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
+{
+    if(tracer) tracer->entry(trace_source(instrument));
+    if(profiler) profiler->begin(PerfCallback::ORDER_BOOK);
+    if(recorder) recorder->book(RecordType::ORDER_BOOK, instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+
+    if(binlog) binlog->log(LogFormat::ORDER_BOOK, instrument, askPrices[0], askVolumes[0], bidPrices[0], bidVolumes[0]);
+
+    order_book(0, instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    if(profiler) profiler->end();
 }
 
-void AutoTrader::OrderStatusMessageHandler(unsigned long clientOrderId,
-                                           unsigned long fillVolume,
-                                           unsigned long remainingVolume,
-                                           signed long fees)
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::order_book(size_t pair, Instrument instrument, unsigned long sequenceNumber,
+                                                  const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
+                                                  const std::array<unsigned long, TOP_LEVEL_COUNT>& askVolumes,
+                                                  const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
+                                                  const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
 {
-    const std::lock_guard<std::mutex> lock(mtx);
-    
-    // RLOG(LG_AT, LogLevel::LL_INFO) << "order " << clientOrderId << " filled for " << fillVolume
-    //                                << " lots at $" << fees << " fees";
-    
-    if(asks.contains(clientOrderId)){
-        asks.update(clientOrderId, remainingVolume);
-    }
+    books[pair][size_t(instrument)].snapshot(sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    features[pair].book(instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    if(tracer) tracer->conflated();
+    if(conflator[pair].book(instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes)) schedule_market_data(pair);
+}
 
-    if(bids.contains(clientOrderId)){
-        bids.update(clientOrderId, remainingVolume);
-    }
 
-    test_place_order();
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::OrderFilledMessageHandler(unsigned long clientOrderId,
+                                                          unsigned long price,
+                                                          unsigned long volume)
+{
+    if(tracer) tracer->entry(TraceSource::EXECUTION);
+    if(profiler) profiler->begin(PerfCallback::ORDER_FILLED);
+    if(recorder) recorder->fill(RecordType::ORDER_FILLED, clientOrderId, price, volume);
+
+    if(binlog) binlog->log(LogFormat::ORDER_FILLED, clientOrderId, volume, price);
+    if(journal) journal_event(JournalType::ORDER_FILLED, clientOrderId, Side::SELL, price, volume);
+
+    book_order_fill(clientOrderId, volume);
+    end_callback();
 }
 
-// TODO: Use this data to infer the current price of future / etf, and to update order accordingly
-void AutoTrader::TradeTicksMessageHandler(Instrument instrument,
-                                          unsigned long sequenceNumber,
-                                          const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
-                                          const std::array<unsigned long, TOP_LEVEL_COUNT>& askVolumes,
-                                          const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
-                                          const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::OrderStatusMessageHandler(unsigned long clientOrderId,
+                                                          unsigned long fillVolume,
+                                                          unsigned long remainingVolume,
+                                                          signed long fees)
 {
-    const std::lock_guard<std::mutex> lock(mtx);
-    
-    // RLOG(LG_AT, LogLevel::LL_INFO) << "trade ticks received for " << instrument << " instrument"
-    //                                << ": ask prices: " << askPrices[0]
-    //                                << "; ask volumes: " << askVolumes[0]
-    //                                << "; bid prices: " << bidPrices[0]
-    //                                << "; bid volumes: " << bidVolumes[0];
+    if(tracer) tracer->entry(TraceSource::EXECUTION);
+    if(profiler) profiler->begin(PerfCallback::ORDER_STATUS);
+    if(recorder) recorder->status(clientOrderId, fillVolume, remainingVolume, fees);
 
-    if (instrument == Instrument::FUTURE) {
-        // for(int i=0;i<5;i++) cout<<askPrices[i]<<'\t'; cout<<endl;
-        // for(int i=0;i<5;i++) cout<<askVolumes[i]<<'\t'; cout<<endl;
-        // for(int i=0;i<5;i++) cout<<bidPrices[i]<<'\t'; cout<<endl;
-        // for(int i=0;i<5;i++) cout<<bidVolumes[i]<<'\t'; cout<<endl;
-
-        int maxask = 0, askvol = 0;
-        int minbid = 1e9, bidvol = 0;
-
-        // cout << theo_fut; 
-        for(int i=0;i<5;i++){
-            if(askVolumes[i] > 200) maxask = max(maxask, (int)askPrices[i]);
-            askvol += askVolumes[i];
-        }
-        for(int i=0;i<5;i++){
-            if(bidVolumes[i] > 200) minbid = min(minbid, (int)bidPrices[i]);
-            bidvol += bidVolumes[i];
-        }
+    if(binlog) binlog->log(LogFormat::ORDER_STATUS, clientOrderId, fillVolume, fees);
+    if(journal) journal_event(JournalType::ORDER_STATUS, clientOrderId, Side::SELL, 0, fillVolume, remainingVolume);
 
-        if(limiter.check_remaining() < 8) return;
-        new_fut_price(maxask, askvol, minbid, bidvol);
+    size_t p = pair_of(clientOrderId);
+    book_order_status(clientOrderId, remainingVolume);
+    test_place_order(p);
+    end_callback();
+}
+
+// Ticks from both instruments add to the traded volume per level in the
+// local books and the features. Future ticks are also conflated into bounds
+// on the future's price, which the estimator folds into theo_fut (see
+// new_fut_price).
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::TradeTicksMessageHandler(Instrument instrument,
+                                                         unsigned long sequenceNumber,
+                                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
+                                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& askVolumes,
+                                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
+                                                         const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
+{
+    if(tracer) tracer->entry(trace_source(instrument));
+    if(profiler) profiler->begin(PerfCallback::TRADE_TICKS);
+    if(recorder) recorder->book(RecordType::TRADE_TICKS, instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+
+    trade_ticks(0, instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    if(profiler) profiler->end();
+}
+
+template<class Policies, size_t Pairs>
+void BasicAutoTrader<Policies, Pairs>::trade_ticks(size_t pair, Instrument instrument, unsigned long sequenceNumber,
+                                                   const std::array<unsigned long, TOP_LEVEL_COUNT>& askPrices,
+                                                   const std::array<unsigned long, TOP_LEVEL_COUNT>& askVolumes,
+                                                   const std::array<unsigned long, TOP_LEVEL_COUNT>& bidPrices,
+                                                   const std::array<unsigned long, TOP_LEVEL_COUNT>& bidVolumes)
+{
+    books[pair][size_t(instrument)].trades(sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    features[pair].ticks(instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes);
+    if (instrument == Instrument::FUTURE) {
+        if(tracer) tracer->conflated();
+        if(conflator[pair].ticks(instrument, sequenceNumber, askPrices, askVolumes, bidPrices, bidVolumes, params.tick_volume))
+            schedule_market_data(pair);
     }
 }
+
+template class BasicAutoTrader<LivePolicies>;
+template class BasicAutoTrader<TopOfBookPolicies>;
+template class BasicAutoTrader<VolumeWeightedTopPolicies>;
+template class BasicAutoTrader<SymmetricPolicies>;
+template class BasicAutoTrader<BandHedgingPolicies>;
+template class BasicAutoTrader<LivePolicies, 16>;
+template class BasicAutoTrader<LivePolicies, 256>;
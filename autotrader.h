@@ -21,143 +21,504 @@
 #include <array>
 #include <memory>
 #include <string>
-#include <unordered_set>
-#include <thread>
 #include <boost/asio/io_context.hpp>
 #include <iostream>
-#include <vector>
 
 #include <ready_trader_go/baseautotrader.h>
 #include <ready_trader_go/types.h>
 
-#include <deque>
+#include "binlog.h"
+#include "clock.h"
+#include "conflation.h"
+#include "estimator.h"
+#include "handlermem.h"
+#include "journal.h"
+#include "latency.h"
+#include "localbook.h"
+#include "lowlatency.h"
+#include "microstructure.h"
+#include "monitor.h"
+#include "perfcounters.h"
+#include "policies.h"
+#include "session.h"
+#include "valuation.h"
+
+#include <atomic>
 #include <chrono>
 #include <limits>
 
 typedef long long ll;
 using namespace std;
 using namespace ReadyTraderGo;
-const int SPEED = 1;
+// Sliding-window message limiter. The timestamps of the last LIMIT admitted
+// messages live in a fixed ring indexed by a monotonically increasing counter,
+// so admission is a single compare-and-swap and never blocks or allocates.
+// The window is measured on the given clock, so a simulation using virtual
+// time sees the same admissions the exchange would.
 class FrequencyLimiter {
 public:
+    explicit FrequencyLimiter(const Clock& clock, int speed = 1) : clock(clock), interval(1020000000LL / speed) {
+        for(auto& e: events) e.store(EMPTY, std::memory_order_relaxed);
+    }
 
     int check_remaining() {
-        const std::lock_guard<std::mutex> lock(mtx);
-        auto now = std::chrono::high_resolution_clock::now();
-        auto window_start = now - interval;
+        long long window_start = clock.now() - interval;
+        unsigned long long head = count.load(std::memory_order_acquire);
+
+        // Slots head, head+1, ... head+LIMIT-1 hold the oldest to the newest
+        // event, so the expired ones form a prefix.
+        int lo = 0, hi = LIMIT;
+        while(lo < hi) {
+            int mid = (lo + hi) / 2;
+            if(at(head + mid) < window_start) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
 
-        while(events.size() > 0 && events.front() < window_start)
-            events.pop_front();
+    bool check_and_add() {
+        long long now = clock.now();
+        unsigned long long head = count.load(std::memory_order_relaxed);
+
+        do {
+            // The slot being reused holds the oldest admission, which must
+            // have left the window.
+            if(at(head) >= now - interval) return false;
+        } while(!count.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
 
-        return limit - events.size();
+        events[head % LIMIT].store(now, std::memory_order_release);
+        return true;
     }
 
-    bool check_and_add() {
-        const std::lock_guard<std::mutex> lock(mtx);
-        auto now = std::chrono::high_resolution_clock::now();
-        auto window_start = now - interval;
-
-        while(events.size() > 0 && events.front() < window_start)
-            events.pop_front();
-        
-        if(events.size() < limit) {
-            events.push_back(now);
-            return true;
+    // Copies up to max admission times still in the window, oldest first,
+    // and returns how many there were.
+    int history(long long* out, int max) const {
+        unsigned long long head = count.load(std::memory_order_acquire);
+        long long window_start = clock.now() - interval;
+        int n = 0;
+        for(int i=0;i<LIMIT && n<max;i++){
+            long long t = at(head + i);
+            if(t != EMPTY && t >= window_start) out[n++] = t;
         }
+        return n;
+    }
 
-        return false;
+    // Counts an admission made before a restart, oldest first. Times ahead
+    // of the clock (from before a reboot) mean nothing and are dropped.
+    void restore(long long t) {
+        if(t > clock.now()) return;
+        unsigned long long head = count.fetch_add(1, std::memory_order_acq_rel);
+        events[head % LIMIT].store(t, std::memory_order_release);
     }
 
 private:
-    std::deque<std::chrono::steady_clock::time_point> events;
-    std::chrono::duration<double> interval = chrono::microseconds( 1020000 / SPEED);
-    int limit = 50;
-    std::mutex mtx; 
+    static constexpr int LIMIT = 50;
+    static constexpr long long EMPTY = std::numeric_limits<long long>::min();
+
+    long long at(unsigned long long i) const {
+        return events[i % LIMIT].load(std::memory_order_acquire);
+    }
+
+    std::array<std::atomic<long long>, LIMIT> events;
+    std::atomic<unsigned long long> count{0};
+    const Clock& clock;
+    long long interval;
 };
 
-struct order{
-    int id = 0, size = 0, price = 0, cancelled = 0;
+// Message classes in decreasing order of importance.
+enum class Priority : uint8_t { CANCEL, HEDGE, QUOTE, PROBE, COUNT };
+
+struct PendingOrder {
+    bool active = false;
+    Side side = Side::BUY;
+    unsigned long id = 0;       // cancels only
+    unsigned long price = 0, volume = 0;
+    bool denied = false;        // counted in BudgetStats::denied already
 };
 
-class orders {
-private:
-    // If order 0 is 0, then order 1 is 0
-    order O[2];
+// Messages sent, pending actions that had to wait for budget (each counted
+// once however often it is retried), and pending actions replaced or dropped
+// before they went out.
+struct BudgetStats {
+    unsigned long sent = 0, denied = 0, superseded = 0;
+};
+
+// Probes the estimator asked for, and the ones probing whenever there was no
+// news of the future for 20ms (the rule before it) would have.
+struct ProbeStats {
+    unsigned long wanted = 0, fixed = 0;
+};
+
+// Decides which class may spend the next message of the rolling window and
+// holds the actions that have to wait for budget. Each class leaves a
+// reserve for the classes above it, and there is at most one pending action
+// per decision (one per cancelled order, per side for quotes, one hedge and
+// one probe, each for every pair), so a newer decision replaces an older one
+// that has not gone out yet. All pairs share the connection's window.
+template<size_t Pairs = 1>
+class MessageScheduler {
+public:
+    explicit MessageScheduler(FrequencyLimiter& limiter) : limiter(limiter) {}
+
+    // Takes a message from the window for the pending action, if its class
+    // may have one.
+    bool admit(Priority p, PendingOrder& pending) {
+        BudgetStats& s = stats[size_t(p)];
+        if(limiter.check_remaining() > RESERVE[size_t(p)] && limiter.check_and_add()) {
+            s.sent++;
+            return true;
+        }
+        if(!pending.denied) s.denied++;
+        pending.denied = true;
+        return false;
+    }
 
-    void place(){
-        if(O[0].id == 0){
-            swap(O[0], O[1]);
+    void queue_cancel(size_t pair, Side side, unsigned long id) {
+        PendingOrder* slot = nullptr;
+        for(auto& c: cancels[pair]) {
+            if(c.active && c.id == id) return;
+            if(!c.active && !slot) slot = &c;
         }
+        if(!slot) slot = &cancels[pair][0];
+        *slot = PendingOrder{true, side, id, 0, 0};
     }
 
+    void queue_insert(size_t pair, Side side, unsigned long price, unsigned long volume) {
+        replace(inserts[pair][side == Side::BUY], PendingOrder{true, side, 0, price, volume}, Priority::QUOTE);
+    }
+
+    // Drops a pending insert for the side that no longer matches the quote price.
+    void retarget(size_t pair, Side side, unsigned long price) {
+        PendingOrder& p = inserts[pair][side == Side::BUY];
+        if(p.active && p.price != price) drop(p, Priority::QUOTE);
+    }
+
+    void queue_hedge(size_t pair, Priority p, Side side, unsigned long price, unsigned long volume) {
+        replace(p == Priority::PROBE ? probe[pair] : hedge[pair], PendingOrder{true, side, 0, price, volume}, p);
+    }
+
+    void drop(PendingOrder& p, Priority c) {
+        if(p.active) stats[size_t(c)].superseded++;
+        p.active = false;
+    }
+
+    const BudgetStats& stats_for(Priority p) const {
+        return stats[size_t(p)];
+    }
+
+    // By pair.
+    std::array<std::array<PendingOrder, 8>, Pairs> cancels;
+    std::array<std::array<PendingOrder, 2>, Pairs> inserts;
+    std::array<PendingOrder, Pairs> hedge, probe;
+
+private:
+    // Messages each class has to leave in the window for the classes above it.
+    // Quotes need two free, as they did before there was a scheduler, so they
+    // share a reserve with hedges; hedges still go first as send_pending()
+    // drains them first.
+    static constexpr int RESERVE[size_t(Priority::COUNT)] = {0, 1, 1, 14};
+
+    void replace(PendingOrder& slot, const PendingOrder& next, Priority c) {
+        if(slot.active) stats[size_t(c)].superseded++;
+        slot = next;
+    }
+
+    FrequencyLimiter& limiter;
+    std::array<BudgetStats, size_t(Priority::COUNT)> stats;
+};
+
+struct Quote {
+    int price, size;
+};
+
+struct QuoteAction {
+    enum Type : int { CANCEL, INSERT } type;
+    int id, price, size;
+};
+
+// The resting orders on one side of the book, at most Capacity of them,
+// packed at the front of a flat array.
+template<int Capacity>
+class OrderLadder {
 public:
-    int totsz(){
-        return O[0].size + O[1].size;
+    int totsz() const {
+        int t = 0;
+        for(int i=0;i<n;i++) t += L[i].size;
+        return t;
+    }
+
+    bool contains_price(int a) const {
+        for(int i=0;i<n;i++) if(L[i].price == a) return true;
+        return false;
+    }
+
+    int cnt() const {
+        return n;
     }
 
-    bool contains(int a) {
-        return (O[0].id == a) || (O[1].id == a);
+    struct Level {
+        int id, price, size, cancelled;
+    };
+
+    // The i-th resting order, for 0 <= i < cnt().
+    Quote at(int i) const {
+        return Quote{L[i].price, L[i].size};
     }
 
-    bool contains_price(int a) {
-        return (O[0].price == a) || (O[1].price == a);
+    const Level& level(int i) const {
+        return L[i];
     }
 
-    int cnt(){
-        return (O[0].id!=0) + (O[1].id!=0);
+    void update(int a, int b){
+        int i = find(a);
+        if(i < 0) return;
+        L[i].size = b;
+        if(b == 0) L[i] = L[--n];
     }
 
-    void update(int a,int b){
-        int i = (O[1].id == a);
-        //assert(O[i].id == a);
-        O[i].size = b;
-        if(b == 0) O[i] = order();
-        place();
+    void cancel(int id) {
+        int i = find(id);
+        if(i >= 0) L[i].cancelled = 1;
     }
 
-    vector<int> to_cancel_ne(int price){
-        //assert(price != 0);
+    void insert(int id, int price, int size){
+        if(n == Capacity) return;
+        L[n++] = Level{id, price, size, 0};
+    }
 
-        vector<int> ret;
-        if(O[0].price != price && O[0].id != 0 && O[0].cancelled == 0){
-            ret.push_back(O[0].id);
+    // Writes the cancels and inserts that turn the live orders into the
+    // desired quotes into out (cancels first) and returns how many there
+    // are. Live orders at a desired price are kept; a desired quote with a
+    // non-positive size only protects the orders at its price. Orders
+    // already being cancelled still hold their slot until they are gone.
+    int diff(const Quote* want, int wants, QuoteAction* out, int max) const {
+        int k = 0;
+        for(int i=0;i<n && k<max;i++){
+            if(L[i].cancelled) continue;
+            bool keep = false;
+            for(int j=0;j<wants;j++) keep |= (want[j].price == L[i].price);
+            if(!keep) out[k++] = QuoteAction{QuoteAction::CANCEL, L[i].id, L[i].price, L[i].size};
         }
 
-        if(O[1].price != price && O[1].id != 0 && O[1].cancelled == 0){
-            ret.push_back(O[1].id);
+        int free = Capacity - n;
+        for(int j=0;j<wants && k<max && free>0;j++){
+            if(want[j].size <= 0 || contains_price(want[j].price)) continue;
+            out[k++] = QuoteAction{QuoteAction::INSERT, 0, want[j].price, want[j].size};
+            free--;
         }
+        return k;
+    }
 
-        return ret;
+private:
+    int find(int id) const {
+        for(int i=0;i<n;i++) if(L[i].id == id) return i;
+        return -1;
     }
 
-    void cancel(int id) {
-        //assert(contains(id));
-        //assert(O[0].id != O[1].id);
-        int i = (O[1].id == id);
-        O[i].cancelled = 1;
+    alignas(64) std::array<Level, Capacity> L{};
+    int n = 0;
+};
+
+typedef OrderLadder<2> orders;
+
+enum class OrderKind : uint8_t { QUOTE, HEDGE };
+enum class OrderState : uint8_t { LIVE, CANCELLING };
+
+struct OrderEntry {
+    unsigned long id = 0;   // 0 marks a free slot
+    Side side = Side::BUY;
+    OrderKind kind = OrderKind::QUOTE;
+    OrderState state = OrderState::LIVE;
+    uint16_t pair = 0;      // whose order it is, see BasicAutoTrader
+};
+
+// Every order we have sent and not yet seen reach a terminal state, keyed by
+// client order id. Fixed-capacity open addressing with linear probing;
+// erase() shifts the following entries back, so there are no tombstones and
+// the table never grows. Ids are handed out in sequence, so they are spread
+// by a multiplicative hash: taken as they are they would fill one long run
+// of slots, which every erase() would have to walk to its end.
+template<size_t Capacity>
+class OrderTable {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    OrderEntry* find(unsigned long id) {
+        for(size_t i = home(id);; i = (i + 1) & MASK) {
+            if(slots[i].id == id) return &slots[i];
+            if(slots[i].id == 0) return nullptr;
+        }
     }
 
-    void insert(int id, int price, int size){
-        //assert(cnt() < 2);
-        //assert(id != 0);
-        int i = cnt();
-        O[i].id = id;
-        O[i].price = price;
-        O[i].size = size;
-        O[i].cancelled = 0;
+    // False, and nothing changes, when the table is full or already holds
+    // the id.
+    bool add(unsigned long id, Side side, OrderKind kind, uint16_t pair = 0) {
+        if(!can_add(id)) return false;
+        size_t i = home(id);
+        while(slots[i].id != 0) i = (i + 1) & MASK;
+        slots[i].id = id;
+        slots[i].side = side;
+        slots[i].kind = kind;
+        slots[i].state = OrderState::LIVE;
+        slots[i].pair = pair;
+        live++;
+        return true;
     }
-    
+
+    bool can_add(unsigned long id) const {
+        if(live + 1 >= Capacity) return false;
+        for(size_t i = home(id); slots[i].id != 0; i = (i + 1) & MASK)
+            if(slots[i].id == id) return false;
+        return true;
+    }
+
+    void erase(unsigned long id) {
+        OrderEntry* e = find(id);
+        if(!e) return;
+        size_t hole = e - slots.data();
+        for(size_t i = (hole + 1) & MASK; slots[i].id != 0; i = (i + 1) & MASK) {
+            // Move an entry back only if the hole lies between its home slot and where it sits now.
+            size_t h = home(slots[i].id);
+            if(((i - h) & MASK) >= ((i - hole) & MASK)) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = OrderEntry();
+        live--;
+    }
+
+    size_t size() const {
+        return live;
+    }
+
+    template<class F>
+    void for_each(F f) const {
+        for(const OrderEntry& e: slots) if(e.id != 0) f(e);
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+    static constexpr int BITS = __builtin_ctzll(Capacity);
+
+    static size_t home(unsigned long id) {
+        return size_t((uint64_t(id) * 0x9E3779B97F4A7C15ull) >> (64 - BITS));
+    }
+    std::array<OrderEntry, Capacity> slots{};
+    size_t live = 0;
+};
+
+// Room for every pair's quotes and hedges at well under half load.
+constexpr size_t order_table_size(size_t pairs)
+{
+    size_t n = 256;
+    while(n < pairs * 8) n *= 2;
+    return n;
+}
+
+// The strategy's tuning constants. The defaults are what runs live.
+struct StrategyParams {
+    int margin = 240;               // distance of the quotes from theo, in cents
+    int etf_clamp = 250;            // per-level volume cap when valuing the ETF book
+    int tick_volume = 200;          // future trade tick volume that bounds the price
+    int hedge_cap = 96;             // most lots the hedge may hold
+    int hedge_fill_offset = 102;    // distance from a hedge fill to the implied future bound
+    int speed = 1;                  // exchange clock speed-up
+    int flow_skew = 0;              // theo shift, in cents per 100 lots of ETF order-flow imbalance
+    int probe_uncertainty = 150;    // future estimate std. dev. that warrants a probe, in cents; 0 probes after 20ms without news
+    int hedge_on_book = 0;          // 1 holds a hedge back until the local future book shows volume at its price
+};
+
+// What the trader records and how it runs, beyond the strategy itself. An
+// empty field leaves that feature off, which is what tools that build many
+// traders want; only the live launcher fills it in, from the environment.
+struct TraderOptions {
+    std::string record;         // capture the session for replay (see session.h)
+    std::string trace;          // tick-to-trade latencies (see latency.h)
+    std::string log;            // binary diagnostics (see logdecode)
+    std::string monitor;        // shared memory name to publish state on (see monitor)
+    std::string journal;        // order journal to survive a restart mid-session
+    std::string perf;           // hardware counters per callback (see perfreport)
+    std::string low_latency;    // busy-poll on a pinned CPU (see lowlatency.h)
+
+    // AUTOTRADER_RECORD, _TRACE, _LOG, _MONITOR, _JOURNAL, _PERF and
+    // _LOW_LATENCY, in that order.
+    static TraderOptions from_environment();
 };
 
-class AutoTrader : public ReadyTraderGo::BaseAutoTrader
+// Receives the outbound order flow in place of the exchange connection,
+// e.g. when a recorded session is replayed. The trader the ready_trader_go
+// launcher builds has none and sends each message with its own write through
+// BaseAutoTrader, so it does not batch; only a launcher that owns the
+// execution socket can install a batching WireSink (see wiresink.h).
+class OrderSink {
+public:
+    virtual ~OrderSink() = default;
+    virtual void insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan lifespan) = 0;
+    virtual void cancel(unsigned long clientOrderId) = 0;
+    virtual void hedge(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume) = 0;
+    // Called as the callback that produced the messages returns, so a sink
+    // can write them out together. Without a sink there is nothing to flush.
+    virtual void flush() {}
+};
+
+// The strategy, with its pricing, quoting and hedging rules given by
+// Policies (a StrategyPolicies, see policies.h), run for Pairs ETF/future
+// pairs over one connection. AutoTrader is the variant that runs live, with
+// the one pair the exchange lists.
+template<class Policies, size_t Pairs = 1>
+class BasicAutoTrader : public ReadyTraderGo::BaseAutoTrader
 {
-    void try_hedge();
+    static_assert(Pairs >= 1 && Pairs <= 65536, "pair ids are 16 bits");
+
+    using Pricing = typename Policies::Pricing;
+    using Quoting = typename Policies::Quoting;
+    using Hedging = typename Policies::Hedging;
+
+    void try_hedge(size_t p);
     void cancellation_loop();
-    std::thread cloop;
-    std::mutex mtx; 
-    int future_l = 0;
+    void probe_future(size_t p);
+    void enable_low_latency(const char* spec);
+    void busy_poll();
+    boost::asio::io_context& context;
+    Clock& clock;
+    std::unique_ptr<Timer> ctimer;
 public:
-    explicit AutoTrader(boost::asio::io_context& context);
+    // How the ready_trader_go launcher builds the trader: default strategy,
+    // steady_clock, and the options from the environment.
+    explicit BasicAutoTrader(boost::asio::io_context& context);
+
+    // Time comes from the given clock, or steady_clock when it is nullptr.
+    // Nothing is read from the environment.
+    BasicAutoTrader(boost::asio::io_context& context, const StrategyParams& params, Clock* clock = nullptr,
+                    const TraderOptions& options = TraderOptions());
+
+    // Divert Send* calls to the given sink (nullptr restores the exchange).
+    void set_order_sink(OrderSink* s) { sink = s; }
+
+    // Message budget use by class, and how often the future was probed.
+    const BudgetStats& budget(Priority p) const { return scheduler.stats_for(p); }
+    const ProbeStats& probes() const { return probe_stats; }
+
+    // Market data for the given pair. The exchange's handlers below feed
+    // pair 0 through these; a tool driving more pairs calls them directly.
+    void order_book(size_t pair, ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+                    const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+                    const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+                    const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+                    const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes);
+    void trade_ticks(size_t pair, ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+                     const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes);
+
+    int theo_of(size_t pair) const { return theo[pair]; }
+    int position_of(size_t pair) const { return mPosition[pair]; }
+    int hedge_of(size_t pair) const { return current_hedge[pair]; }
+
+    // Capture every inbound callback to the given file (see session.h).
+    bool record_session(const char* path);
 
     // Called when the execution connection is lost.
     void DisconnectHandler() override;
@@ -225,32 +586,109 @@ private:
     unsigned long mAskPrice = 0;
     unsigned long mBidId = 0;
     unsigned long mBidPrice = 0;
-    unsigned long newAskPrice = 0;
-    unsigned long newBidPrice = 0;
-    bool start = 0;
-    FrequencyLimiter limiter;
+    StrategyParams params;
+    FrequencyLimiter limiter{clock, params.speed};
+    ProbeStats probe_stats;
+    MessageScheduler<Pairs> scheduler{limiter};
+    bool md_scheduled = false;
+    HandlerMemory md_memory;
+    // Pairs with market data waiting for the posted handler, in arrival order.
+    std::array<uint16_t, Pairs> md_queue{};
+    std::array<bool, Pairs> md_queued{};
+    size_t md_waiting = 0;
     int AC = 0;
     int BC = 0;
-    int mPosition = 0;
-    int etfA = 0, etfB = 0;
-    int theo_fut = -1, theo_etf = -1, theo = -1;
-    int target_hedge = 0;
-    int current_hedge = 0;
-    int cc = 0;
-
-    orders asks, bids;
-    
-    unordered_set<int> hedgeS,hedgeB;
-    
-    std::chrono::steady_clock::time_point last_future_info = std::chrono::high_resolution_clock::now();
-    
-    void test_place_order();
+
+    // Everything below is by pair, one array per field, so a callback only
+    // touches its own pair's entries.
+    std::array<unsigned long, Pairs> newAskPrice{}, newBidPrice{};
+    std::array<bool, Pairs> start{};
+    // Starts out growing as fast as the 20ms rule assumed: from a book's
+    // 50 cents to 150 in 20ms.
+    std::array<FutureEstimator, Pairs> fut_estimator;
+    std::array<MarketDataConflator, Pairs> conflator;
+    std::array<FeatureEngine<>, Pairs> features;
+    std::array<std::array<LocalBook<>, 2>, Pairs> books;    // then by instrument
+    std::array<int, Pairs> mPosition{};
+    std::array<int, Pairs> etfA{}, etfB{};
+    std::array<int, Pairs> theo_fut, theo_etf, theo;
+    std::array<int, Pairs> target_hedge{};
+    std::array<int, Pairs> current_hedge{};
+    std::array<int, Pairs> cc{};
+    std::array<bool, Pairs> future_l{};             // a hedge or probe is in flight
+    std::array<long long, Pairs> last_future_info;
+
+    std::array<orders, Pairs> asks, bids;
+
+    OrderTable<order_table_size(Pairs)> live;
+
+    OrderSink* sink = nullptr;
+    std::unique_ptr<SessionRecorder> recorder;
+    std::unique_ptr<LatencyTracer> tracer;
+    std::unique_ptr<BinaryLogger> binlog;
+    std::unique_ptr<StateMonitor> monitor;
+    std::unique_ptr<OrderJournal> journal;
+    std::unique_ptr<CallbackProfiler> profiler;
+    TracePath trace_path = TracePath::NONE;
+
+    // Wake-up latency: how late the periodic timer fires, and in busy-poll
+    // mode the time between two idle polls.
+    bool spinning = false;
+    double ticks_per_ns = 1;
+    long long timer_deadline = 0;
+    LatencyHistogram timer_late, poll_gap;
+
+    void test_place_order(size_t p);
     void test_get_info();
-    void cancel_and_place();
-    void new_fut_price(int maxask, int askvol, int minbid, int bidvol);
-    bool rate_limited_cancel(unsigned long clientOrderId);
-    bool rate_limited_hedge(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume);
-    bool rate_limited_insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan lifespan);
+    void cancel_and_place(size_t p);
+    void cancelled(orders& side, int id);
+    void requote(size_t p, orders& ladder, Side side, const Quote& want);
+    void schedule_market_data(size_t p);
+    void process_market_data();
+    void process_market_data(size_t p);
+    void update_theo(size_t p);
+    void end_callback();
+    void publish_state();
+    void open_journal(const char* path);
+    void restore(const JournalCheckpoint& c);
+    void recover(const JournalRecord& r);
+    void write_checkpoint(bool closed = false);
+    void journal_event(JournalType type, unsigned long clientOrderId, Side side,
+                       unsigned long price = 0, unsigned long volume = 0, unsigned long remaining = 0);
+    void book_order_fill(unsigned long clientOrderId, unsigned long volume);
+    void book_order_status(unsigned long clientOrderId, unsigned long remainingVolume);
+    bool book_hedge_fill(unsigned long clientOrderId, unsigned long volume, Side& side, size_t& p);
+    size_t pair_of(unsigned long clientOrderId);
+    void new_fut_price(size_t p, int maxask, int askvol, int minbid, int bidvol);
+    void send_cancel(unsigned long clientOrderId);
+    void send_hedge(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume);
+    void send_insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan lifespan);
+    void submit_cancel(size_t p, Side side, unsigned long clientOrderId);
+    void submit_hedge(size_t p, Priority priority, Side side, unsigned long price, unsigned long volume);
+    void submit_insert(size_t p, Side side, unsigned long price, unsigned long volume);
+    bool trackable(unsigned long clientOrderId);
+    bool send_pending_hedge(size_t p, PendingOrder& hedge, Priority priority);
+    void send_pending(size_t p);
 };
 
+using LivePolicies = StrategyPolicies<WeightedPricing, SkewedQuoting, CappedHedging>;
+using AutoTrader = BasicAutoTrader<LivePolicies>;
+
+// Variants compiled alongside the live one, for comparing them (see
+// policybench). A new combination needs a line here and in autotrader.cc.
+using TopOfBookPolicies = StrategyPolicies<TopOfBookPricing, SkewedQuoting, CappedHedging>;
+using VolumeWeightedTopPolicies = StrategyPolicies<VolumeWeightedTopPricing, SkewedQuoting, CappedHedging>;
+using SymmetricPolicies = StrategyPolicies<WeightedPricing, SymmetricQuoting, CappedHedging>;
+using BandHedgingPolicies = StrategyPolicies<WeightedPricing, SkewedQuoting, BandHedging<10>>;
+
+extern template class BasicAutoTrader<LivePolicies>;
+extern template class BasicAutoTrader<TopOfBookPolicies>;
+extern template class BasicAutoTrader<VolumeWeightedTopPolicies>;
+extern template class BasicAutoTrader<SymmetricPolicies>;
+extern template class BasicAutoTrader<BandHedgingPolicies>;
+
+// The live strategy over many pairs (see pairbench).
+extern template class BasicAutoTrader<LivePolicies, 16>;
+extern template class BasicAutoTrader<LivePolicies, 256>;
+
 #endif //CPPREADY_TRADER_GO_AUTOTRADER_H
@@ -0,0 +1,218 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_BACKTEST_H
+#define CPPREADY_TRADER_GO_BACKTEST_H
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include "autotrader.h"
+#include "session.h"
+
+// Runs a trader over the market data of a session captured with
+// AUTOTRADER_RECORD, against a simulated exchange. Shared by sweep, which
+// varies StrategyParams, and policybench, which varies the policies.
+
+struct BacktestResult {
+    long long pnl = 0;              // cents, marked to the last mids
+    long long etf_volume = 0;       // lots traded on the ETF
+    long long hedge_volume = 0;     // lots traded on the future
+    long long fills = 0;
+    long long messages = 0;         // inserts + cancels + hedges
+    long long position = 0;         // ETF position at the end
+    long long probes = 0;           // probe hedges sent
+    long long fixed_probes = 0;     // probes the 20ms rule would have asked for
+};
+
+// A small matching simulation. Resting quotes fill when the ETF trades at or
+// through their price, hedges fill against the future book up to their
+// limit price, and the resulting execution messages are queued until
+// deliver() hands them to the trader.
+class SimExchange : public OrderSink {
+public:
+    void insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan) override {
+        result.messages++;
+        quotes.push_back(Resting{clientOrderId, side, (long)price, (long)volume, 0, 0});
+    }
+
+    void cancel(unsigned long clientOrderId) override {
+        result.messages++;
+        for(size_t i=0;i<quotes.size();i++){
+            if(quotes[i].id != clientOrderId) continue;
+            events.push_back(Event{Event::STATUS, clientOrderId, 0, (unsigned long)quotes[i].filled, 0, quotes[i].fees});
+            quotes.erase(quotes.begin() + i);
+            return;
+        }
+    }
+
+    void hedge(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume) override {
+        result.messages++;
+        const BookSnapshot& b = future;
+        long left = volume, filled = 0, cost = 0;
+        for(size_t i=0;i<TOP_LEVEL_COUNT && left>0;i++){
+            long p = side == Side::BUY ? b.askPrices[i] : b.bidPrices[i];
+            long v = side == Side::BUY ? b.askVolumes[i] : b.bidVolumes[i];
+            if(p == 0 || v == 0) break;
+            if(side == Side::BUY ? p > (long)price : p < (long)price) break;
+            long q = std::min(left, v);
+            filled += q;
+            cost += q * p;
+            left -= q;
+        }
+        unsigned long average = filled ? cost / filled : 0;
+        if(filled){
+            long sign = side == Side::BUY ? 1 : -1;
+            future_position += sign * filled;
+            cash -= sign * cost;
+            result.hedge_volume += filled;
+        }
+        events.push_back(Event{Event::HEDGE, clientOrderId, average, (unsigned long)filled, 0, 0});
+    }
+
+    void market_data(const SessionRecord& r) {
+        if(r.type() == RecordType::ORDER_BOOK){
+            BookSnapshot& b = r.instrument() == Instrument::FUTURE ? future : etf;
+            b.askPrices = r.askPrices;
+            b.askVolumes = r.askVolumes;
+            b.bidPrices = r.bidPrices;
+            b.bidVolumes = r.bidVolumes;
+        } else if(r.type() == RecordType::TRADE_TICKS && r.instrument() == Instrument::ETF) {
+            match(r);
+        }
+    }
+
+    template<class Trader>
+    void deliver(Trader& trader) {
+        // Handlers may send more orders, which can queue more events.
+        for(size_t i=0;i<events.size();i++){
+            Event e = events[i];
+            switch(e.type){
+            case Event::FILL:
+                trader.OrderFilledMessageHandler(e.id, e.price, e.volume);
+                break;
+            case Event::STATUS:
+                trader.OrderStatusMessageHandler(e.id, e.volume, e.remaining, e.fees);
+                break;
+            case Event::HEDGE:
+                trader.HedgeFilledMessageHandler(e.id, e.price, e.volume);
+                break;
+            }
+        }
+        events.clear();
+    }
+
+    BacktestResult finish() {
+        long long etf_mid = (etf.askPrices[0] + etf.bidPrices[0]) / 2;
+        long long future_mid = (future.askPrices[0] + future.bidPrices[0]) / 2;
+        result.pnl = cash + etf_position * etf_mid + future_position * future_mid;
+        result.position = etf_position;
+        return result;
+    }
+
+private:
+    struct Resting {
+        unsigned long id;
+        Side side;
+        long price, remaining, filled, fees;
+    };
+
+    struct Event {
+        enum Type { FILL, STATUS, HEDGE } type;
+        unsigned long id, price, volume, remaining;
+        long fees;
+    };
+
+    // Trades on the ask side were buyers lifting offers, so they fill our
+    // asks at or below the traded price; likewise for bids.
+    void match(const SessionRecord& r) {
+        for(size_t k=0;k<quotes.size();){
+            Resting& q = quotes[k];
+            long traded = 0;
+            for(size_t i=0;i<TOP_LEVEL_COUNT;i++){
+                if(q.side == Side::SELL && r.askVolumes[i] && (long)r.askPrices[i] >= q.price) traded += r.askVolumes[i];
+                if(q.side == Side::BUY && r.bidVolumes[i] && (long)r.bidPrices[i] <= q.price) traded += r.bidVolumes[i];
+            }
+            long v = std::min(traded, q.remaining);
+            if(v == 0){
+                k++;
+                continue;
+            }
+
+            // Passive fills earn the maker rebate of 1bp.
+            long fee = -(q.price * v / 10000);
+            long sign = q.side == Side::BUY ? 1 : -1;
+            etf_position += sign * v;
+            cash -= sign * q.price * v + fee;
+            q.remaining -= v;
+            q.filled += v;
+            q.fees += fee;
+            result.etf_volume += v;
+            result.fills++;
+
+            events.push_back(Event{Event::FILL, q.id, (unsigned long)q.price, (unsigned long)v, 0, 0});
+            events.push_back(Event{Event::STATUS, q.id, 0, (unsigned long)q.filled, (unsigned long)q.remaining, q.fees});
+            if(q.remaining == 0) quotes.erase(quotes.begin() + k);
+            else k++;
+        }
+    }
+
+    BookSnapshot future, etf;
+    std::vector<Resting> quotes;
+    std::vector<Event> events;
+    long long cash = 0, etf_position = 0, future_position = 0;
+    BacktestResult result;
+};
+
+// Each run keeps its own virtual clock driven by the recorded receive times,
+// so timeouts and the message limit behave as they did live.
+template<class Trader>
+BacktestResult backtest(const std::vector<SessionRecord>& session, const StrategyParams& params)
+{
+    boost::asio::io_context context;
+    // Virtual timers do not count as io_context work, so keep it from
+    // stopping once the queue is drained.
+    auto work = boost::asio::make_work_guard(context);
+    VirtualClock clock;
+    // No instrumentation: sweep runs many of these at once, and they would
+    // share its files, CPU pin and busy-poll loop.
+    Trader trader(context, params, &clock, TraderOptions());
+    SimExchange exchange;
+    trader.set_order_sink(&exchange);
+
+    int64_t origin = session.empty() ? 0 : session.front().header.timestamp;
+    for(const SessionRecord& r: session){
+        clock.advance_to(r.header.timestamp - origin);
+        exchange.market_data(r);
+        if(r.type() == RecordType::ORDER_BOOK)
+            trader.OrderBookMessageHandler(r.instrument(), r.header.sequence, r.askPrices, r.askVolumes, r.bidPrices, r.bidVolumes);
+        else
+            trader.TradeTicksMessageHandler(r.instrument(), r.header.sequence, r.askPrices, r.askVolumes, r.bidPrices, r.bidVolumes);
+        context.poll();
+        exchange.deliver(trader);
+        context.poll();
+    }
+    BacktestResult result = exchange.finish();
+    result.probes = trader.budget(Priority::PROBE).sent;
+    result.fixed_probes = trader.probes().fixed;
+    return result;
+}
+
+#endif //CPPREADY_TRADER_GO_BACKTEST_H
@@ -0,0 +1,141 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_BINLOG_H
+#define CPPREADY_TRADER_GO_BINLOG_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+#include "spsc.h"
+
+// Binary diagnostic log. The trading thread only copies a format id and the
+// raw arguments into a fixed-size record on an SpscRing; a writer thread
+// appends the records to disk in batches, and format_log_record() (used by
+// the logdecode tool) turns them back into the usual text lines.
+
+enum class LogFormat : uint16_t {
+    ORDER_BOOK,      // instrument, ask price, ask volume, bid price, bid volume
+    HEDGE_FILLED,    // client order id, volume, price
+    ORDER_FILLED,    // client order id, volume, price
+    ORDER_STATUS,    // client order id, fill volume, fees
+    COUNT
+};
+
+struct LogRecord {
+    int64_t timestamp;      // system_clock nanoseconds
+    uint16_t format;
+    uint16_t count;
+    uint32_t reserved;
+    int64_t args[6];
+};
+
+static_assert(sizeof(LogRecord) == 64, "log records should stay one cache line");
+
+// Writes the text for one record into out and returns its length.
+inline int format_log_record(const LogRecord& r, char* out, size_t size) {
+    time_t seconds = time_t(r.timestamp / 1000000000);
+    struct tm t;
+    gmtime_r(&seconds, &t);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &t);
+    int n = std::snprintf(out, size, "%s.%06lld [INFO] [AUTO] ", stamp, (long long)(r.timestamp % 1000000000 / 1000));
+    if(n < 0 || size_t(n) >= size) return n;
+
+    const int64_t* a = r.args;
+    static const char* instruments[] = {"FUTURE", "ETF"};
+    switch(LogFormat(r.format)){
+    case LogFormat::ORDER_BOOK:
+        return n + std::snprintf(out + n, size - n,
+                                 "order book received for %s instrument: ask prices: %lld; ask volumes: %lld; bid prices: %lld; bid volumes: %lld",
+                                 instruments[a[0] & 1], (long long)a[1], (long long)a[2], (long long)a[3], (long long)a[4]);
+    case LogFormat::HEDGE_FILLED:
+        return n + std::snprintf(out + n, size - n, "hedge order %lld filled for %lld lots at $%lld average price in cents",
+                                 (long long)a[0], (long long)a[1], (long long)a[2]);
+    case LogFormat::ORDER_FILLED:
+        return n + std::snprintf(out + n, size - n, "order %lld filled for %lld lots at $%lld cents",
+                                 (long long)a[0], (long long)a[1], (long long)a[2]);
+    case LogFormat::ORDER_STATUS:
+        return n + std::snprintf(out + n, size - n, "order %lld filled for %lld lots at $%lld fees",
+                                 (long long)a[0], (long long)a[1], (long long)a[2]);
+    case LogFormat::COUNT:
+        break;
+    }
+    return n + std::snprintf(out + n, size - n, "unknown log format %u", unsigned(r.format));
+}
+
+class BinaryLogger {
+public:
+    explicit BinaryLogger(const char* path) : file(std::fopen(path, "wb")) {
+        if(file) writer = std::thread(&BinaryLogger::drain, this);
+    }
+
+    ~BinaryLogger() {
+        running.store(false, std::memory_order_release);
+        if(writer.joinable()) writer.join();
+        if(file) std::fclose(file);
+    }
+
+    BinaryLogger(const BinaryLogger&) = delete;
+    BinaryLogger& operator=(const BinaryLogger&) = delete;
+
+    bool ok() const { return file != nullptr; }
+
+    size_t drops() const { return ring.drops(); }
+
+    // The writer thread; not joinable when the file could not be opened.
+    std::thread& worker() { return writer; }
+
+    template<class... Args>
+    void log(LogFormat format, Args... args) {
+        static_assert(sizeof...(Args) <= 6, "too many log arguments");
+        LogRecord r{};
+        r.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        r.format = uint16_t(format);
+        r.count = uint16_t(sizeof...(Args));
+        int i = 0;
+        ((r.args[i++] = int64_t(args)), ...);
+        ring.push(r);
+    }
+
+private:
+    void drain() {
+        std::array<LogRecord, 256> batch;
+        while(true){
+            bool stopping = !running.load(std::memory_order_acquire);
+            size_t n = 0;
+            while(n < batch.size() && ring.pop(batch[n])) n++;
+            if(n) std::fwrite(batch.data(), sizeof(LogRecord), n, file);
+            else if(stopping) break;
+            else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::fflush(file);
+    }
+
+    SpscRing<LogRecord, 1 << 14> ring;
+    std::FILE* file;
+    std::atomic<bool> running{true};
+    std::thread writer;
+};
+
+#endif //CPPREADY_TRADER_GO_BINLOG_H
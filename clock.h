@@ -0,0 +1,160 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_CLOCK_H
+#define CPPREADY_TRADER_GO_CLOCK_H
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "handlermem.h"
+
+// Where the strategy gets its time from. Times are nanoseconds on a
+// monotonic scale; only differences between them mean anything.
+
+class Timer {
+public:
+    virtual ~Timer() = default;
+    // Calls fn once, delay nanoseconds from now, replacing any earlier wait.
+    virtual void expires_after(long long delay, std::function<void()> fn) = 0;
+    virtual void cancel() = 0;
+};
+
+class Clock {
+public:
+    virtual ~Clock() = default;
+    virtual long long now() const = 0;
+    virtual std::unique_ptr<Timer> make_timer(boost::asio::io_context& context) = 0;
+};
+
+class AsioTimer : public Timer {
+public:
+    explicit AsioTimer(boost::asio::io_context& context) : timer(context) {}
+
+    void expires_after(long long delay, std::function<void()> fn) override {
+        timer.expires_after(std::chrono::nanoseconds(delay));
+        timer.async_wait(allocated_handler(memory, [fn](const boost::system::error_code& error){
+            if(!error) fn();
+        }));
+    }
+
+    void cancel() override {
+        timer.cancel();
+    }
+
+private:
+    boost::asio::steady_timer timer;
+    HandlerMemory memory;
+};
+
+class RealClock : public Clock {
+public:
+    long long now() const override {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::unique_ptr<Timer> make_timer(boost::asio::io_context& context) override {
+        return std::unique_ptr<Timer>(new AsioTimer(context));
+    }
+};
+
+inline Clock& real_clock() {
+    static RealClock clock;
+    return clock;
+}
+
+// Discrete-event time. The clock only moves when advance_to() is called, and
+// timers due on the way fire in order with now() set to their deadline, so a
+// simulation reproduces every timeout and rate-limit window exactly however
+// fast it runs.
+class VirtualClock : public Clock {
+public:
+    long long now() const override {
+        return t;
+    }
+
+    std::unique_ptr<Timer> make_timer(boost::asio::io_context&) override {
+        return std::unique_ptr<Timer>(new VirtualTimer(*this));
+    }
+
+    void advance_to(long long target) {
+        while(!events.empty() && events.front().at <= target){
+            std::pop_heap(events.begin(), events.end(), later);
+            Event e = events.back();
+            events.pop_back();
+            t = std::max(t, e.at);
+            e.fn();
+        }
+        t = std::max(t, target);
+    }
+
+private:
+    class VirtualTimer : public Timer {
+    public:
+        explicit VirtualTimer(VirtualClock& clock) : clock(clock) {}
+        ~VirtualTimer() override { cancel(); }
+
+        void expires_after(long long delay, std::function<void()> fn) override {
+            cancel();
+            clock.schedule(this, clock.t + delay, std::move(fn));
+        }
+
+        void cancel() override {
+            clock.forget(this);
+        }
+
+    private:
+        VirtualClock& clock;
+    };
+
+    struct Event {
+        long long at;
+        unsigned long seq;
+        const Timer* owner;
+        std::function<void()> fn;
+    };
+
+    static bool later(const Event& a, const Event& b) {
+        return a.at != b.at ? a.at > b.at : a.seq > b.seq;
+    }
+
+    void schedule(const Timer* owner, long long at, std::function<void()> fn) {
+        events.push_back(Event{at, seq++, owner, std::move(fn)});
+        std::push_heap(events.begin(), events.end(), later);
+    }
+
+    void forget(const Timer* owner) {
+        auto end = std::remove_if(events.begin(), events.end(), [owner](const Event& e){ return e.owner == owner; });
+        if(end == events.end()) return;
+        events.erase(end, events.end());
+        std::make_heap(events.begin(), events.end(), later);
+    }
+
+    long long t = 0;
+    unsigned long seq = 0;
+    std::vector<Event> events;
+};
+
+#endif //CPPREADY_TRADER_GO_CLOCK_H
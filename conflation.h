@@ -0,0 +1,127 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_CONFLATION_H
+#define CPPREADY_TRADER_GO_CONFLATION_H
+
+#include <algorithm>
+#include <array>
+
+#include <ready_trader_go/types.h>
+
+// Market data that arrived since the strategy last ran. Only the newest book
+// per instrument is kept, trade ticks are merged, and anything that is not
+// newer than what was already seen is dropped.
+
+struct BookSnapshot {
+    bool dirty = false;
+    unsigned long sequence = 0;
+    std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> askPrices{}, askVolumes{}, bidPrices{}, bidVolumes{};
+};
+
+// Highest ask and lowest bid that traded heavily, and the total volume
+// traded on each side, over all merged trade tick messages.
+struct TickSummary {
+    bool dirty = false;
+    unsigned long sequence = 0;
+    int maxask = 0, askvol = 0;
+    int minbid = 1e9, bidvol = 0;
+};
+
+struct ConflationStats {
+    unsigned long books = 0, ticks = 0;
+    unsigned long conflated = 0;   // superseded or merged before the strategy ran
+    unsigned long stale = 0;       // duplicate or out-of-order sequence number
+    unsigned long gaps = 0;        // messages missing between two sequence numbers
+};
+
+class MarketDataConflator {
+public:
+    bool book(ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) {
+        stats.books++;
+        BookSnapshot& b = books[size_t(instrument)];
+        if(!accept(b.sequence, sequenceNumber)) return false;
+        if(b.dirty) stats.conflated++;
+        b.dirty = true;
+        b.askPrices = askPrices;
+        b.askVolumes = askVolumes;
+        b.bidPrices = bidPrices;
+        b.bidVolumes = bidVolumes;
+        return true;
+    }
+
+    // Levels that traded more than heavy lots count towards maxask/minbid.
+    bool ticks(ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes,
+               unsigned long heavy) {
+        stats.ticks++;
+        TickSummary& t = trades[size_t(instrument)];
+        if(!accept(t.sequence, sequenceNumber)) return false;
+        if(t.dirty) stats.conflated++;
+        t.dirty = true;
+        for(size_t i=0;i<ReadyTraderGo::TOP_LEVEL_COUNT;i++){
+            if(askVolumes[i] > heavy) t.maxask = std::max(t.maxask, (int)askPrices[i]);
+            t.askvol += askVolumes[i];
+            if(bidVolumes[i] > heavy) t.minbid = std::min(t.minbid, (int)bidPrices[i]);
+            t.bidvol += bidVolumes[i];
+        }
+        return true;
+    }
+
+    // Hands the pending book over and clears it; nullptr if nothing is pending.
+    const BookSnapshot* take_book(ReadyTraderGo::Instrument instrument) {
+        BookSnapshot& b = books[size_t(instrument)];
+        if(!b.dirty) return nullptr;
+        b.dirty = false;
+        return &b;
+    }
+
+    bool take_ticks(ReadyTraderGo::Instrument instrument, TickSummary& out) {
+        TickSummary& t = trades[size_t(instrument)];
+        if(!t.dirty) return false;
+        out = t;
+        unsigned long sequence = t.sequence;
+        t = TickSummary();
+        t.sequence = sequence;
+        return true;
+    }
+
+    ConflationStats stats;
+
+private:
+    bool accept(unsigned long& last, unsigned long sequenceNumber) {
+        if(last != 0 && sequenceNumber <= last) {
+            stats.stale++;
+            return false;
+        }
+        if(last != 0 && sequenceNumber > last + 1) stats.gaps += sequenceNumber - last - 1;
+        last = sequenceNumber;
+        return true;
+    }
+
+    std::array<BookSnapshot, 2> books;
+    std::array<TickSummary, 2> trades;
+};
+
+#endif //CPPREADY_TRADER_GO_CONFLATION_H
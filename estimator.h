@@ -0,0 +1,124 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_ESTIMATOR_H
+#define CPPREADY_TRADER_GO_ESTIMATOR_H
+
+#include <algorithm>
+
+// The future's price as the trader knows it, and how far off that might be
+// by now. Everything that says something about the price goes through here:
+//
+// - A book sets the price to its value and the uncertainty to BOOK_SD.
+// - A trade tick or hedge fill is a bound: the price is at least, or at
+//   most, the traded price. A bound that moves the price leaves BOUND_SD of
+//   uncertainty; one that does not still rules out everything past it.
+// - A hedge that found nothing to trade with is a bound PROBE_OFFSET away.
+//
+// In between, the variance grows linearly with time like a random walk's.
+// The rate is learned from how far each book moved from the previous
+// estimate, as an exponential average with weight 1 / 2^SHIFT, so a quiet
+// market lets the estimate go unchecked for longer. Everything is integer,
+// in cents and clock nanoseconds, so replays reproduce bit for bit.
+class FutureEstimator {
+public:
+    static constexpr long long BOOK_SD = 50;
+    static constexpr long long BOUND_SD = 50;
+    static constexpr int PROBE_OFFSET = 100;    // a probe's distance from the estimate
+    static constexpr int SHIFT = 3;
+    static constexpr long long SECOND = 1000000000LL;
+
+    // drift is the variance's starting growth rate, in cents^2 per second of
+    // the clock.
+    explicit FutureEstimator(long long drift = 1000000) : drift(drift) {}
+
+    int value() const { return estimate; }
+
+    // cents^2
+    long long variance(long long now) const {
+        if(!ready) return UNKNOWN;
+        long long dt = std::max(0LL, std::min(now - since, MAX_GAP));
+        return std::min(UNKNOWN, var + drift * (dt / 1000) / (SECOND / 1000));
+    }
+
+    long long drift_rate() const { return drift; }
+
+    // True once the standard deviation is above sd.
+    bool uncertain(long long now, long long sd) const {
+        return variance(now) > sd * sd;
+    }
+
+    void book(int value, long long now) {
+        if(books) {
+            long long e = std::max(-MAX_MOVE, std::min((long long)value - estimate, MAX_MOVE));
+            long long dt = std::max(MIN_GAP, std::min(now - last_book, MAX_GAP));
+            long long sample = std::min(e * e * (SECOND / 1000) / (dt / 1000), MAX_DRIFT);
+            drift += (sample - drift) >> SHIFT;
+        }
+        books++;
+        last_book = now;
+        estimate = value;
+        set(BOOK_SD * BOOK_SD, now);
+    }
+
+    void at_least(int bound, long long now) {
+        if(estimate < bound) {
+            estimate = bound;
+            narrow(BOUND_SD * BOUND_SD, now);
+        } else narrow(std::max(BOUND_SD * BOUND_SD, ((long long)estimate - bound) * ((long long)estimate - bound)), now);
+    }
+
+    void at_most(int bound, long long now) {
+        if(estimate > bound) {
+            estimate = bound;
+            narrow(BOUND_SD * BOUND_SD, now);
+        } else narrow(std::max(BOUND_SD * BOUND_SD, ((long long)bound - estimate) * ((long long)bound - estimate)), now);
+    }
+
+    void missed(long long now) {
+        narrow((long long)PROBE_OFFSET * PROBE_OFFSET, now);
+    }
+
+private:
+    static constexpr long long UNKNOWN = 1LL << 40;
+    static constexpr long long MIN_GAP = 1000000;          // 1ms
+    static constexpr long long MAX_GAP = 10 * SECOND;
+    // Keep the arithmetic well inside 64 bits whatever the books do.
+    static constexpr long long MAX_MOVE = 100000;
+    static constexpr long long MAX_DRIFT = 100000000000LL;
+
+    void set(long long v, long long now) {
+        var = v;
+        since = now;
+        ready = true;
+    }
+
+    // Bounds only ever make the estimate surer.
+    void narrow(long long v, long long now) {
+        if(ready) set(std::min(v, variance(now)), now);
+    }
+
+    int estimate = -1;
+    long long var = UNKNOWN;
+    long long since = 0;
+    bool ready = false;
+    long long drift;
+    long long last_book = 0;
+    unsigned long books = 0;
+};
+
+#endif //CPPREADY_TRADER_GO_ESTIMATOR_H
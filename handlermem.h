@@ -0,0 +1,106 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_HANDLERMEM_H
+#define CPPREADY_TRADER_GO_HANDLERMEM_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Fixed storage for an asio handler that is never outstanding more than once
+// at a time, e.g. a re-armed timer wait or a deduplicated post. asio picks
+// the allocator up from the handler, so the operation costs no heap call on
+// any thread. A second concurrent handler, or one that does not fit, falls
+// back to operator new.
+class HandlerMemory {
+public:
+    HandlerMemory() = default;
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* allocate(std::size_t size) {
+        if(!in_use && size <= sizeof(storage)) {
+            in_use = true;
+            return &storage;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* p) {
+        if(p == &storage) in_use = false;
+        else ::operator delete(p);
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char storage[256];
+    bool in_use = false;
+};
+
+template<class T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) : memory(&memory) {}
+
+    template<class U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory(other.memory) {}
+
+    T* allocate(std::size_t n) const {
+        return static_cast<T*>(memory->allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* p, std::size_t) const {
+        memory->deallocate(p);
+    }
+
+    bool operator==(const HandlerAllocator& other) const noexcept { return memory == other.memory; }
+    bool operator!=(const HandlerAllocator& other) const noexcept { return memory != other.memory; }
+
+private:
+    template<class> friend class HandlerAllocator;
+    HandlerMemory* memory;
+};
+
+template<class Handler>
+class AllocatedHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    AllocatedHandler(HandlerMemory& memory, Handler h) : memory(memory), handler(std::move(h)) {}
+
+    allocator_type get_allocator() const noexcept {
+        return allocator_type(memory);
+    }
+
+    template<class... Args>
+    void operator()(Args&&... args) {
+        handler(std::forward<Args>(args)...);
+    }
+
+private:
+    HandlerMemory& memory;
+    Handler handler;
+};
+
+template<class Handler>
+AllocatedHandler<Handler> allocated_handler(HandlerMemory& memory, Handler h) {
+    return AllocatedHandler<Handler>(memory, std::move(h));
+}
+
+#endif //CPPREADY_TRADER_GO_HANDLERMEM_H
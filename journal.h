@@ -0,0 +1,204 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_JOURNAL_H
+#define CPPREADY_TRADER_GO_JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Write-ahead journal of the trader's order state, so a process that dies
+// mid-session can pick up where it left off. The file is mapped into memory
+// and appending is a handful of stores: the kernel writes the pages back on
+// its own, and they survive the process (but not the machine) going down.
+//
+// The file holds two checkpoint slots followed by a ring of records. A
+// checkpoint is a complete copy of the state and starts a new generation;
+// the records of that generation follow it from the start of the ring, and
+// the first record carrying an older generation ends the log. Generations are
+// stored last, so a checkpoint or record cut short by a crash is never read.
+
+enum class JournalType : uint8_t {
+    INSERT = 1,
+    CANCEL = 2,
+    HEDGE = 3,
+    ORDER_FILLED = 4,
+    ORDER_STATUS = 5,
+    HEDGE_FILLED = 6,
+};
+
+struct JournalRecord {
+    int64_t time;                  // trader clock, ns
+    std::atomic<uint32_t> generation;
+    uint8_t type, side;            // side is only meaningful for sends
+    uint16_t reserved;
+    uint32_t clientOrderId, price, volume;
+    uint32_t remaining;            // order status only
+
+    JournalType kind() const { return JournalType(type); }
+};
+
+struct JournalOrder {
+    uint32_t clientOrderId, price, volume;
+    uint8_t side, hedge, cancelling, reserved;
+};
+
+constexpr uint32_t JOURNAL_MAGIC = 0x52544a4c;   // "RTJL"
+constexpr uint32_t JOURNAL_VERSION = 1;
+constexpr int JOURNAL_ORDERS = 256;
+constexpr int JOURNAL_SENDS = 64;
+
+struct JournalCheckpoint {
+    std::atomic<uint32_t> generation;
+    uint32_t closed;               // written on a clean disconnect: nothing to recover
+    int64_t time;
+    uint32_t next_id;
+    int32_t position, current_hedge;
+    uint32_t orders, sends;
+    int64_t send_times[JOURNAL_SENDS];   // recent admissions to the message window, oldest first
+    JournalOrder order[JOURNAL_ORDERS];
+};
+
+struct JournalHeader {
+    uint32_t magic, version, record_size, capacity;
+    alignas(64) JournalCheckpoint slots[2];
+};
+
+static_assert(sizeof(JournalRecord) == 32, "records are laid out for the file");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "generations are read back by another process");
+
+class OrderJournal {
+public:
+    // Maps the file, creating it with room for capacity records if needed.
+    // An existing file keeps its capacity.
+    explicit OrderJournal(const char* path, uint32_t capacity = 1 << 16) {
+        int fd = open(path, O_CREAT | O_RDWR, 0644);
+        if(fd < 0) return;
+        off_t end = lseek(fd, 0, SEEK_END);
+        uint32_t existing[4];     // magic, version, record_size, capacity
+        if(end >= off_t(sizeof(JournalHeader)) && pread(fd, existing, sizeof(existing), 0) == sizeof(existing)
+           && existing[0] == JOURNAL_MAGIC && existing[1] == JOURNAL_VERSION
+           && existing[2] == sizeof(JournalRecord) && end == off_t(file_size(existing[3])))
+            capacity = existing[3];
+        else
+            end = 0;
+
+        size = file_size(capacity);
+        if(end == 0 && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)) {
+            close(fd);
+            return;
+        }
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+        close(fd);
+        if(p == MAP_FAILED) return;
+
+        header = static_cast<JournalHeader*>(p);
+        records = reinterpret_cast<JournalRecord*>(static_cast<char*>(p) + sizeof(JournalHeader));
+        if(end == 0) {
+            header->magic = JOURNAL_MAGIC;
+            header->version = JOURNAL_VERSION;
+            header->record_size = sizeof(JournalRecord);
+            header->capacity = capacity;
+        }
+        this->capacity = header->capacity;
+
+        // Pick up after the newest checkpoint and its records.
+        latest = newest();
+        if(latest) {
+            generation = latest->generation.load(std::memory_order_acquire);
+            while(tail < this->capacity && records[tail].generation.load(std::memory_order_acquire) == generation) tail++;
+        }
+    }
+
+    ~OrderJournal() {
+        if(header) munmap(header, size);
+    }
+
+    OrderJournal(const OrderJournal&) = delete;
+    OrderJournal& operator=(const OrderJournal&) = delete;
+
+    bool ok() const { return header != nullptr; }
+
+    // The state found on disk: the newest checkpoint, or nullptr, and the
+    // records that followed it. Both change with the next checkpoint().
+    const JournalCheckpoint* recovered() const { return latest; }
+    const JournalRecord* begin() const { return records; }
+    const JournalRecord* end() const { return records + tail; }
+
+    // Records written since the last checkpoint.
+    uint32_t pending() const { return tail; }
+
+    // False when the ring is full; take a checkpoint and try again.
+    bool append(JournalType type, int64_t time, unsigned long clientOrderId, uint8_t side = 0,
+                unsigned long price = 0, unsigned long volume = 0, unsigned long remaining = 0) {
+        if(tail == capacity) return false;
+        JournalRecord& r = records[tail++];
+        r.time = time;
+        r.type = uint8_t(type);
+        r.side = side;
+        r.reserved = 0;
+        r.clientOrderId = uint32_t(clientOrderId);
+        r.price = uint32_t(price);
+        r.volume = uint32_t(volume);
+        r.remaining = uint32_t(remaining);
+        r.generation.store(generation, std::memory_order_release);
+        return true;
+    }
+
+    // Fill the returned checkpoint (everything but its generation), then
+    // call commit(). Until then the previous checkpoint stays the newest.
+    JournalCheckpoint& checkpoint() {
+        JournalCheckpoint& c = header->slots[(generation + 1) & 1];
+        c.generation.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return c;
+    }
+
+    void commit() {
+        JournalCheckpoint& c = header->slots[(generation + 1) & 1];
+        c.generation.store(++generation, std::memory_order_release);
+        latest = &c;
+        tail = 0;
+    }
+
+private:
+    static size_t file_size(uint32_t capacity) {
+        return sizeof(JournalHeader) + size_t(capacity) * sizeof(JournalRecord);
+    }
+
+    const JournalCheckpoint* newest() const {
+        const JournalCheckpoint* best = nullptr;
+        for(const JournalCheckpoint& c: header->slots) {
+            uint32_t g = c.generation.load(std::memory_order_acquire);
+            if(g && (!best || g > best->generation.load(std::memory_order_relaxed))) best = &c;
+        }
+        return best;
+    }
+
+    JournalHeader* header = nullptr;
+    JournalRecord* records = nullptr;
+    const JournalCheckpoint* latest = nullptr;
+    size_t size = 0;
+    uint32_t capacity = 0, tail = 0, generation = 0;
+};
+
+#endif //CPPREADY_TRADER_GO_JOURNAL_H
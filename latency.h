@@ -0,0 +1,265 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_LATENCY_H
+#define CPPREADY_TRADER_GO_LATENCY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "spsc.h"
+
+// Tick-to-trade tracing. The trading thread stamps a few points of every
+// callback with the TSC and pushes them into an SpscRing; a background
+// thread writes the raw events to disk and folds them into histograms.
+
+inline uint64_t tsc_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Waits for earlier instructions to retire, so a stamp taken right before a
+// send is not hoisted above the work that produced it.
+inline uint64_t tsc_now_ordered() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned aux;
+    return __rdtscp(&aux);
+#else
+    return tsc_now();
+#endif
+}
+
+// TSC ticks per nanosecond, measured once against steady_clock.
+inline double tsc_calibrate() {
+    auto c0 = std::chrono::steady_clock::now();
+    uint64_t t0 = tsc_now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto c1 = std::chrono::steady_clock::now();
+    uint64_t t1 = tsc_now();
+    double ns = std::chrono::duration<double, std::nano>(c1 - c0).count();
+    return ns > 0 ? (t1 - t0) / ns : 1.0;
+}
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is
+// split into SUB equal buckets, giving about 3% relative precision over the
+// whole 64-bit range in a fixed 15KB table.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 5;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    void record(uint64_t v) {
+        counts[bucket(v)]++;
+        total++;
+        if(v > maximum) maximum = v;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maximum; }
+
+    // Lower bound of the bucket holding the given quantile (0..1).
+    uint64_t percentile(double q) const {
+        if(total == 0) return 0;
+        uint64_t rank = uint64_t(q * (total - 1)), seen = 0;
+        for(int i=0;i<BUCKETS;i++){
+            seen += counts[i];
+            if(seen > rank) return lower_bound(i);
+        }
+        return maximum;
+    }
+
+private:
+    static int bucket(uint64_t v) {
+        if(v < SUB) return int(v);
+        int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+        return (shift + 1) * SUB + int((v >> shift) - SUB);
+    }
+
+    static uint64_t lower_bound(int i) {
+        if(i < SUB) return i;
+        int shift = i / SUB - 1;
+        return uint64_t(i % SUB + SUB) << shift;
+    }
+
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0;
+    uint64_t maximum = 0;
+};
+
+// BATCH opens the posted handler that acts on conflated market data. Its
+// stamp is the entry of the earliest update folded into the batch, so the
+// sends it causes are timed from when the oldest of their inputs arrived.
+enum class TraceKind : uint8_t { ENTRY, THEO, SEND, BATCH };
+
+// What woke the trading thread up.
+enum class TraceSource : uint8_t { FUTURE, ETF, EXECUTION, TIMER, COUNT };
+
+// Which piece of strategy logic decided to send.
+enum class TracePath : uint8_t { NONE, CANCEL_AND_PLACE, TRY_HEDGE, NEW_FUT_PRICE, TEST_PLACE_ORDER, PROBE_FUTURE, COUNT };
+
+enum class TraceMessage : uint8_t { NONE, INSERT, CANCEL, HEDGE };
+
+struct TraceEvent {
+    uint64_t tsc;
+    TraceKind kind;
+    TraceSource source;
+    TracePath path;
+    TraceMessage message;
+    uint32_t clientOrderId;     // for BATCH, how many updates it folded
+};
+
+class LatencyTracer {
+public:
+    // Raw events go to path, the histogram summary to path + ".hist".
+    explicit LatencyTracer(const std::string& path)
+        : file(std::fopen(path.c_str(), "wb")), summary(path + ".hist"), ticks_per_ns(tsc_calibrate()) {
+        if(file) drainer = std::thread(&LatencyTracer::drain, this);
+    }
+
+    ~LatencyTracer() {
+        running.store(false, std::memory_order_release);
+        if(drainer.joinable()) drainer.join();
+        if(file) std::fclose(file);
+        write_summary();
+    }
+
+    LatencyTracer(const LatencyTracer&) = delete;
+    LatencyTracer& operator=(const LatencyTracer&) = delete;
+
+    bool ok() const { return file != nullptr; }
+
+    // The drain thread; not joinable when the file could not be opened.
+    std::thread& worker() { return drainer; }
+
+    void entry(TraceSource source) {
+        current = source;
+        entry_stamp = tsc_now();
+        ring.push(TraceEvent{entry_stamp, TraceKind::ENTRY, source, TracePath::NONE, TraceMessage::NONE, 0});
+    }
+
+    // The callback just entered handed its update to the conflator.
+    void conflated() {
+        if(!batch_updates++) {
+            batch_stamp = entry_stamp;
+            batch_source = current;
+        }
+    }
+
+    // The conflated updates are being acted on; what follows is timed from
+    // the earliest of them.
+    void batch() {
+        if(!batch_updates) return;
+        current = batch_source;
+        ring.push(TraceEvent{batch_stamp, TraceKind::BATCH, batch_source, TracePath::NONE, TraceMessage::NONE, batch_updates});
+        batch_updates = 0;
+    }
+
+    void theo() {
+        ring.push(TraceEvent{tsc_now(), TraceKind::THEO, current, TracePath::NONE, TraceMessage::NONE, 0});
+    }
+
+    void send(TracePath path, TraceMessage message, unsigned long clientOrderId) {
+        ring.push(TraceEvent{tsc_now_ordered(), TraceKind::SEND, current, path, message, uint32_t(clientOrderId)});
+    }
+
+private:
+    void drain() {
+        std::array<TraceEvent, 1024> batch;
+        while(true){
+            bool stopping = !running.load(std::memory_order_acquire);
+            size_t n = 0;
+            while(n < batch.size() && ring.pop(batch[n])) n++;
+            for(size_t i=0;i<n;i++) account(batch[i]);
+            if(n) std::fwrite(batch.data(), sizeof(TraceEvent), n, file);
+            else if(stopping) break;
+            else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void account(const TraceEvent& e) {
+        switch(e.kind){
+        case TraceKind::ENTRY:
+        case TraceKind::BATCH:
+            entry_tsc = e.tsc;
+            break;
+        case TraceKind::THEO:
+            theo_hist[size_t(e.source)].record(to_ns(e.tsc - entry_tsc));
+            break;
+        case TraceKind::SEND:
+            send_hist[size_t(e.source)][size_t(e.path)].record(to_ns(e.tsc - entry_tsc));
+            break;
+        }
+    }
+
+    uint64_t to_ns(uint64_t ticks) const {
+        return uint64_t(ticks / ticks_per_ns);
+    }
+
+    void write_summary() const {
+        std::FILE* out = std::fopen(summary.c_str(), "w");
+        if(!out) return;
+        static const char* sources[] = {"FUTURE", "ETF", "EXECUTION", "TIMER"};
+        static const char* paths[] = {"-", "cancel_and_place", "try_hedge", "new_fut_price", "test_place_order", "probe_future"};
+        auto line = [out](const char* source, const char* what, const LatencyHistogram& h){
+            if(h.count() == 0) return;
+            std::fprintf(out, "%-10s %-22s %10llu %10llu %10llu %10llu %10llu\n", source, what,
+                         (unsigned long long)h.count(), (unsigned long long)h.percentile(0.5),
+                         (unsigned long long)h.percentile(0.99), (unsigned long long)h.percentile(0.999),
+                         (unsigned long long)h.max());
+        };
+        std::fprintf(out, "%-10s %-22s %10s %10s %10s %10s %10s\n", "source", "stage", "count", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+        for(size_t s=0;s<size_t(TraceSource::COUNT);s++){
+            line(sources[s], "theo", theo_hist[s]);
+            for(size_t p=0;p<size_t(TracePath::COUNT);p++) line(sources[s], paths[p], send_hist[s][p]);
+        }
+        std::fprintf(out, "dropped events: %zu\n", ring.drops());
+        std::fclose(out);
+    }
+
+    SpscRing<TraceEvent, 1 << 16> ring;
+    TraceSource current = TraceSource::EXECUTION;
+    uint64_t entry_stamp = 0;
+    uint64_t batch_stamp = 0;
+    TraceSource batch_source = TraceSource::EXECUTION;
+    uint32_t batch_updates = 0;
+
+    std::FILE* file;
+    std::string summary;
+    double ticks_per_ns;
+    std::atomic<bool> running{true};
+    std::thread drainer;
+
+    // Only touched by the drain thread.
+    uint64_t entry_tsc = 0;
+    std::array<LatencyHistogram, size_t(TraceSource::COUNT)> theo_hist;
+    std::array<std::array<LatencyHistogram, size_t(TracePath::COUNT)>, size_t(TraceSource::COUNT)> send_hist;
+};
+
+#endif //CPPREADY_TRADER_GO_LATENCY_H
@@ -0,0 +1,141 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Compares FrequencyLimiter with the mutex and deque limiter it replaced,
+// with 1 to N threads hammering one limiter the way MessageScheduler::admit
+// does: check_remaining(), then check_and_add(). Two windows are run:
+//     full      the exchange's 1.02s, so after the first 50 admissions
+//               every call is a denial, as when the budget is spent
+//     rolling   1us, so slots expire all the time and calls are admitted
+// Each line gives the wall time per admit() call over all threads, and how
+// many were admitted.
+//
+// Build alongside autotrader.cc against the ready_trader_go library:
+//     limiterbench [calls per thread] [max threads]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "autotrader.h"
+
+// The limiter as it was: a mutex, a deque of time points, and a scan from
+// the front on every call. It read high_resolution_clock into a deque of
+// steady_clock points; both are steady_clock here so it compiles wherever
+// the two differ.
+class MutexLimiter {
+public:
+    explicit MutexLimiter(long long interval_ns) : interval(std::chrono::nanoseconds(interval_ns)) {}
+
+    int check_remaining() {
+        const std::lock_guard<std::mutex> lock(mtx);
+        auto now = std::chrono::steady_clock::now();
+        auto window_start = now - interval;
+
+        while(events.size() > 0 && events.front() < window_start)
+            events.pop_front();
+
+        return limit - events.size();
+    }
+
+    bool check_and_add() {
+        const std::lock_guard<std::mutex> lock(mtx);
+        auto now = std::chrono::steady_clock::now();
+        auto window_start = now - interval;
+
+        while(events.size() > 0 && events.front() < window_start)
+            events.pop_front();
+
+        if(events.size() < (size_t)limit) {
+            events.push_back(now);
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    std::deque<std::chrono::steady_clock::time_point> events;
+    std::chrono::nanoseconds interval;
+    int limit = 50;
+    std::mutex mtx;
+};
+
+struct Result {
+    double ns_per_call;
+    long admitted;
+};
+
+// Wall time over all calls on all threads, so the figure means the same
+// whether the threads get a CPU each or share one.
+template<class Limiter>
+static Result run(Limiter& limiter, int threads, long calls)
+{
+    std::atomic<int> ready{0};
+    std::atomic<long> admitted{0};
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for(int t=0;t<threads;t++){
+        workers.emplace_back([&]{
+            ready++;
+            while(ready.load() < threads) std::this_thread::yield();
+            long mine = 0;
+            for(long i=0;i<calls;i++)
+                mine += limiter.check_remaining() > 0 && limiter.check_and_add();
+            admitted += mine;
+        });
+    }
+    for(auto& w: workers) w.join();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return Result{ns / threads / calls, admitted.load()};
+}
+
+int main(int argc, char* argv[])
+{
+    long calls = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : int(std::thread::hardware_concurrency());
+    if(calls < 1 || max_threads < 1){
+        std::fprintf(stderr, "usage: %s [calls per thread >= 1] [max threads >= 1]\n", argv[0]);
+        return 1;
+    }
+
+    RealClock clock;
+    struct Window { const char* name; int speed; } windows[] = {{"full", 1}, {"rolling", 1020000}};
+
+    std::vector<int> counts;
+    for(int threads=1;threads<max_threads;threads*=2) counts.push_back(threads);
+    counts.push_back(max_threads);
+
+    std::printf("%-8s %8s %16s %12s %16s %12s\n", "window", "threads", "mutex ns/call", "admitted", "ring ns/call", "admitted");
+    for(const Window& w: windows){
+        for(int threads: counts){
+            MutexLimiter before(1020000000LL / w.speed);
+            FrequencyLimiter after(clock, w.speed);
+            Result a = run(before, threads, calls);
+            Result b = run(after, threads, calls);
+            std::printf("%-8s %8d %16.1f %12ld %16.1f %12ld\n", w.name, threads, a.ns_per_call, a.admitted,
+                        b.ns_per_call, b.admitted);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_LOCALBOOK_H
+#define CPPREADY_TRADER_GO_LOCALBOOK_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include <ready_trader_go/types.h>
+
+// A persistent book for one instrument, kept as flat arrays indexed by price
+// in ticks over a window of Ticks prices. Which prices hold volume is kept in
+// a two-level bitmap per side (a bit per price, and a summary bit per 64
+// prices), so the best price and the depth at a price are O(1), and walking
+// the book only visits prices that hold volume.
+//
+// Each snapshot replaces what it covers: every level from the touch out to
+// its fifth price. Deeper levels seen in earlier snapshots are kept as the
+// best guess there is until a snapshot reaches them again. Trade ticks add
+// to the volume traded at each price and remember the message that did.
+//
+// The exchange's price range is far wider than any window, so the window is
+// placed around the first snapshot and moved (dropping everything) if the
+// market leaves it.
+template<size_t Ticks = 1024>
+class LocalBook {
+    static_assert(Ticks % 64 == 0 && Ticks <= 64 * 64, "the summary word covers at most 64 words");
+
+public:
+    explicit LocalBook(unsigned long tick = 100) : tick(tick) {}
+
+    // False, and nothing changes, for a message that is not newer than the
+    // last one of its kind.
+    bool snapshot(unsigned long sequenceNumber,
+                  const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+                  const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+                  const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+                  const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) {
+        if(sequenceNumber <= book_sequence) return false;
+        book_sequence = sequenceNumber;
+
+        unsigned long touch = askPrices[0] ? askPrices[0] : bidPrices[0];
+        if(touch && (!placed || !inside(askPrices) || !inside(bidPrices))) place(touch);
+
+        merge(asks, askPrices, askVolumes, true);
+        merge(bids, bidPrices, bidVolumes, false);
+        return true;
+    }
+
+    bool trades(unsigned long sequenceNumber,
+                const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+                const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+                const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+                const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) {
+        if(sequenceNumber <= trade_sequence) return false;
+        trade_sequence = sequenceNumber;
+        for(size_t i=0;i<ReadyTraderGo::TOP_LEVEL_COUNT;i++){
+            trade(askPrices[i], askVolumes[i], sequenceNumber);
+            trade(bidPrices[i], bidVolumes[i], sequenceNumber);
+        }
+        return true;
+    }
+
+    // 0 when the side is empty.
+    unsigned long best_ask() const { return asks.empty() ? 0 : price(asks.lowest()); }
+    unsigned long best_bid() const { return bids.empty() ? 0 : price(bids.highest()); }
+
+    // Volume resting at the price on the given side.
+    unsigned long depth(ReadyTraderGo::Side side, unsigned long p) const {
+        const Levels& l = side == ReadyTraderGo::Side::SELL ? asks : bids;
+        return on_grid(p) ? l.volume[index(p)] : 0;
+    }
+
+    // Volume resting on the given side from its best price out to p,
+    // inclusive: what an order at p could take. Not O(1): it adds up every
+    // level holding volume on the way, skipping 64 empty prices per bit
+    // scan, so it costs as many adds as there are levels between the touch
+    // and p. A price beyond the window counts the whole side.
+    unsigned long volume_to(ReadyTraderGo::Side side, unsigned long p) const {
+        unsigned long v = 0;
+        if(side == ReadyTraderGo::Side::SELL) {
+            if(p < base) return 0;
+            size_t hi = std::min<unsigned long>(Ticks - 1, (p - base) / tick);
+            asks.for_each(0, hi, [&](size_t k){ v += asks.volume[k]; });
+        } else {
+            size_t lo = p <= base ? 0 : (p - base + tick - 1) / tick;
+            if(lo >= Ticks) return 0;
+            bids.for_each(lo, Ticks - 1, [&](size_t k){ v += bids.volume[k]; });
+        }
+        return v;
+    }
+
+    // Volume traded at the price since the window was placed.
+    unsigned long traded(unsigned long p) const { return on_grid(p) ? traded_volume[index(p)] : 0; }
+
+    // Sequence number of the last trade tick message with a trade at the
+    // price, 0 if there was none.
+    unsigned long last_traded(unsigned long p) const { return on_grid(p) ? traded_at[index(p)] : 0; }
+
+private:
+    static constexpr size_t WORDS = Ticks / 64;
+
+    struct Levels {
+        std::array<uint32_t, Ticks> volume{};
+        std::array<uint64_t, WORDS> bits{};
+        uint64_t summary = 0;
+
+        bool empty() const { return summary == 0; }
+
+        size_t lowest() const {
+            size_t w = __builtin_ctzll(summary);
+            return w * 64 + __builtin_ctzll(bits[w]);
+        }
+
+        size_t highest() const {
+            size_t w = 63 - __builtin_clzll(summary);
+            return w * 64 + 63 - __builtin_clzll(bits[w]);
+        }
+
+        void set(size_t i, uint32_t v) {
+            volume[i] = v;
+            bits[i / 64] |= 1ull << (i % 64);
+            summary |= 1ull << (i / 64);
+        }
+
+        // Calls f with every index in [lo, hi] that holds volume, lowest first.
+        template<class F>
+        void for_each(size_t lo, size_t hi, F f) const {
+            for(size_t w = lo / 64; w <= hi / 64; w++){
+                if(!(summary >> w & 1)) continue;
+                uint64_t m = bits[w];
+                if(w == lo / 64) m &= ~0ull << (lo % 64);
+                if(w == hi / 64 && hi % 64 != 63) m &= (1ull << (hi % 64 + 1)) - 1;
+                for(;m;m&=m-1) f(w * 64 + __builtin_ctzll(m));
+            }
+        }
+
+        void clear(size_t lo, size_t hi) {
+            for(size_t w = lo / 64; w <= hi / 64; w++){
+                uint64_t m = bits[w];
+                if(w == lo / 64) m &= ~0ull << (lo % 64);
+                if(w == hi / 64 && hi % 64 != 63) m &= (1ull << (hi % 64 + 1)) - 1;
+                for(uint64_t r = m;r;r&=r-1) volume[w * 64 + __builtin_ctzll(r)] = 0;
+                bits[w] &= ~m;
+                if(!bits[w]) summary &= ~(1ull << w);
+            }
+        }
+    };
+
+    bool on_grid(unsigned long p) const {
+        return p >= base && p < base + Ticks * tick && p % tick == 0;
+    }
+
+    size_t index(unsigned long p) const { return (p - base) / tick; }
+    unsigned long price(size_t i) const { return base + i * tick; }
+
+    bool inside(const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& prices) const {
+        for(unsigned long p: prices) if(p && !(p >= base && p < base + Ticks * tick)) return false;
+        return true;
+    }
+
+    // Centres the window on the price and forgets everything.
+    void place(unsigned long touch) {
+        unsigned long centre = touch / tick;
+        base = (centre > Ticks / 2 ? centre - Ticks / 2 : 0) * tick;
+        asks = Levels();
+        bids = Levels();
+        traded_volume.fill(0);
+        traded_at.fill(0);
+        placed = true;
+    }
+
+    // The snapshot's side, best first, replaces everything from the side's
+    // best possible price out to its last shown level.
+    void merge(Levels& l, const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& prices,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& volumes, bool ask) {
+        size_t n = 0;
+        while(n < ReadyTraderGo::TOP_LEVEL_COUNT && prices[n]) n++;
+        if(n == 0) {
+            l.clear(0, Ticks - 1);
+            return;
+        }
+        // A spread wider than half the window can leave the far side's
+        // deeper levels outside it.
+        unsigned long p = prices[n - 1];
+        size_t last = p < base ? 0 : p >= base + Ticks * tick ? Ticks - 1 : index(p);
+        if(ask) l.clear(0, last);
+        else l.clear(last, Ticks - 1);
+        for(size_t i=0;i<n;i++) if(volumes[i] && on_grid(prices[i])) l.set(index(prices[i]), uint32_t(volumes[i]));
+    }
+
+    void trade(unsigned long p, unsigned long volume, unsigned long sequenceNumber) {
+        if(!volume || !on_grid(p)) return;
+        size_t i = index(p);
+        traded_volume[i] += uint32_t(volume);
+        traded_at[i] = uint32_t(sequenceNumber);
+    }
+
+    unsigned long tick;
+    unsigned long base = 0;
+    bool placed = false;
+    unsigned long book_sequence = 0, trade_sequence = 0;
+    Levels asks, bids;
+    std::array<uint32_t, Ticks> traded_volume{}, traded_at{};
+};
+
+#endif //CPPREADY_TRADER_GO_LOCALBOOK_H
@@ -0,0 +1,173 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Feeds LocalBook a random walk of snapshots and trade ticks and checks
+// every query against a plain std::map book merged the same way. The touch
+// must also be what the snapshot itself shows, as the handlers read it
+// before there was a local book. Halfway through the market jumps out of
+// the window, so the book has to move it.
+//
+//     localbookcheck [iterations] [seed]
+// Exits with status 1 if anything disagreed.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+
+#include "localbook.h"
+
+using ReadyTraderGo::Side;
+using Prices = std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>;
+
+// What LocalBook should hold, kept the slow way.
+struct ReferenceBook {
+    std::map<unsigned long, unsigned long> asks, bids;
+    std::map<unsigned long, std::pair<unsigned long, unsigned long>> traded;   // volume, last sequence
+
+    void clear() {
+        asks.clear();
+        bids.clear();
+        traded.clear();
+    }
+
+    // Each side replaces everything from the touch out to its last level.
+    void snapshot(const Prices& ap, const Prices& av, int na, const Prices& bp, const Prices& bv, int nb) {
+        if(na == 0) asks.clear();
+        else asks.erase(asks.begin(), asks.upper_bound(ap[na - 1]));
+        for(int i=0;i<na;i++) asks[ap[i]] = av[i];
+        if(nb == 0) bids.clear();
+        else bids.erase(bids.lower_bound(bp[nb - 1]), bids.end());
+        for(int i=0;i<nb;i++) bids[bp[i]] = bv[i];
+    }
+
+    unsigned long volume_to(Side side, unsigned long p) const {
+        unsigned long v = 0;
+        if(side == Side::SELL) for(auto& e: asks) v += e.first <= p ? e.second : 0;
+        else for(auto& e: bids) v += e.first >= p ? e.second : 0;
+        return v;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    long iterations = argc > 1 ? std::atol(argv[1]) : 200000;
+    unsigned seed = argc > 2 ? unsigned(std::atol(argv[2])) : 7;
+    if(iterations < 2){
+        std::fprintf(stderr, "usage: %s [iterations >= 2] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    LocalBook<1024> book;
+    ReferenceBook ref;
+    long mid = 15000;
+    unsigned long sequence = 0, trade_sequence = 0;
+    long errors = 0, checks = 0;
+    // Before the first snapshot and after the jump the book has no window
+    // over the market, so trades there cannot be kept.
+    bool unplaced = true;
+    auto fail = [&](long it, const char* what, long p, unsigned long got, unsigned long want){
+        if(errors++ < 10) std::printf("iteration %ld: %s at %ld is %lu, want %lu\n", it, what, p, got, want);
+    };
+
+    for(long it=0;it<iterations;it++){
+        // Keep the walk well inside one window, then jump far out of it.
+        bool second = it >= iterations / 2;
+        mid += 100 * (int(rng() % 3) - 1);
+        if(it == iterations / 2) {
+            mid += 200000;
+            unplaced = true;
+        }
+        mid = second ? std::max(185000L, std::min(245000L, mid)) : std::max(5000L, std::min(90000L, mid));
+
+        Prices ap{}, av{}, bp{}, bv{};
+        int na = rng() % 6, nb = rng() % 6;
+        unsigned long a = mid + 100 * (1 + rng() % 2), b = mid - 100 * (rng() % 2);
+        for(int i=0;i<na;i++){
+            ap[i] = a;
+            av[i] = 1 + rng() % 300;
+            a += 100 * (1 + rng() % 2);
+        }
+        for(int i=0;i<nb;i++){
+            bp[i] = b;
+            bv[i] = 1 + rng() % 300;
+            b -= 100 * (1 + rng() % 2);
+        }
+
+        // The next snapshot with a touch places the window.
+        bool jump = unplaced && (ap[0] || bp[0]);
+        if(rng() % 4 == 0 && !jump){
+            if(unplaced) continue;
+            Prices tp{}, tv{}, up{}, uv{};
+            tp[0] = ap[0];
+            tv[0] = ap[0] ? 5 : 0;
+            up[0] = bp[0];
+            uv[0] = bp[0] ? 7 : 0;
+            book.trades(++trade_sequence, tp, tv, up, uv);
+            if(tp[0]) ref.traded[tp[0]] = {ref.traded[tp[0]].first + 5, trade_sequence};
+            if(up[0]) ref.traded[up[0]] = {ref.traded[up[0]].first + 7, trade_sequence};
+            continue;
+        }
+        if(jump) {
+            ref.clear();
+            unplaced = false;
+        }
+        book.snapshot(++sequence, ap, av, bp, bv);
+        ref.snapshot(ap, av, na, bp, bv, nb);
+
+        // An old snapshot changes nothing.
+        if(book.snapshot(sequence - 1, Prices{}, Prices{}, Prices{}, Prices{})) fail(it, "stale snapshot", 0, 1, 0);
+
+        // The touch the handlers used to take from the snapshot.
+        if(na && book.best_ask() != ap[0]) fail(it, "best ask", 0, book.best_ask(), ap[0]);
+        if(nb && book.best_bid() != bp[0]) fail(it, "best bid", 0, book.best_bid(), bp[0]);
+        unsigned long best_ask = ref.asks.empty() ? 0 : ref.asks.begin()->first;
+        unsigned long best_bid = ref.bids.empty() ? 0 : ref.bids.rbegin()->first;
+        if(book.best_ask() != best_ask) fail(it, "best ask", 0, book.best_ask(), best_ask);
+        if(book.best_bid() != best_bid) fail(it, "best bid", 0, book.best_bid(), best_bid);
+
+        for(long p = mid - 3000; p <= mid + 3000; p += 50){
+            auto a = ref.asks.find(p), b = ref.bids.find(p);
+            unsigned long da = a == ref.asks.end() ? 0 : a->second, db = b == ref.bids.end() ? 0 : b->second;
+            if(book.depth(Side::SELL, p) != da) fail(it, "ask depth", p, book.depth(Side::SELL, p), da);
+            if(book.depth(Side::BUY, p) != db) fail(it, "bid depth", p, book.depth(Side::BUY, p), db);
+            if(book.volume_to(Side::SELL, p) != ref.volume_to(Side::SELL, p))
+                fail(it, "ask volume to", p, book.volume_to(Side::SELL, p), ref.volume_to(Side::SELL, p));
+            if(book.volume_to(Side::BUY, p) != ref.volume_to(Side::BUY, p))
+                fail(it, "bid volume to", p, book.volume_to(Side::BUY, p), ref.volume_to(Side::BUY, p));
+            auto t = ref.traded.find(p);
+            unsigned long tv = t == ref.traded.end() ? 0 : t->second.first, ts = t == ref.traded.end() ? 0 : t->second.second;
+            if(book.traded(p) != tv) fail(it, "traded", p, book.traded(p), tv);
+            if(book.last_traded(p) != ts) fail(it, "last traded", p, book.last_traded(p), ts);
+            checks += 6;
+        }
+        // Prices off either end of the window.
+        for(unsigned long p: {0UL, 1000000UL}){
+            if(book.volume_to(Side::SELL, p) != ref.volume_to(Side::SELL, p))
+                fail(it, "ask volume to", p, book.volume_to(Side::SELL, p), ref.volume_to(Side::SELL, p));
+            if(book.volume_to(Side::BUY, p) != ref.volume_to(Side::BUY, p))
+                fail(it, "bid volume to", p, book.volume_to(Side::BUY, p), ref.volume_to(Side::BUY, p));
+            checks += 2;
+        }
+    }
+
+    std::printf("%ld checks over %ld iterations, %ld disagreed\n", checks, iterations, errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Turns a binary log written with AUTOTRADER_LOG back into text:
+//     logdecode <binary log>
+
+#include <cstdio>
+
+#include "binlog.h"
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2){
+        std::fprintf(stderr, "usage: %s <binary log>\n", argv[0]);
+        return 1;
+    }
+
+    std::FILE* in = std::fopen(argv[1], "rb");
+    if(!in){
+        std::fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    LogRecord r;
+    char line[512];
+    while(std::fread(&r, sizeof(r), 1, in) == 1){
+        format_log_record(r, line, sizeof(line));
+        std::puts(line);
+    }
+
+    std::fclose(in);
+    return 0;
+}
@@ -0,0 +1,657 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// A stand-in for the exchange that runs on the loopback interface, so the
+// compiled autotrader can be stressed without network access. It accepts the
+// execution connection over TCP, publishes order books and trade ticks for
+// both instruments as UDP datagrams, and matches the trader's ETF orders
+// against a synthetic book and a synthetic crowd of takers that follow a
+// random-walk price. Hedges fill against the synthetic future book.
+//
+// The exchange's limits are enforced: tick size, active orders, active
+// volume, position and the message frequency limit. A breach is reported
+// with an error message, and --strict also drops the connection like the
+// real exchange does.
+//
+// On exit it reports the message counts, the busiest frequency window, and
+// the time from publishing an order book to receiving the next order message,
+// which is the trader's full socket-to-send round trip.
+//
+//     loopback [--exec-port N] [--info-port N] [--rate STEPS_PER_S]
+//              [--speed N] [--volatility CENTS] [--flow P] [--seed N]
+//              [--duration S] [--strict]
+//
+// Point the trader's Execution and Information settings at 127.0.0.1 and
+// the two ports.
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+
+#include <ready_trader_go/types.h>
+
+#include "clock.h"
+#include "wire.h"
+
+using namespace ReadyTraderGo;
+using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
+
+typedef std::array<unsigned long, TOP_LEVEL_COUNT> Levels;
+
+static constexpr unsigned long TICK = 100;
+static constexpr long POSITION_LIMIT = 100;
+static constexpr size_t ACTIVE_ORDER_LIMIT = 10;
+static constexpr unsigned long ACTIVE_VOLUME_LIMIT = 200;
+static constexpr size_t MESSAGE_LIMIT = 50;
+static constexpr long long MESSAGE_WINDOW = 1000000000LL;
+
+struct Options {
+    unsigned short exec_port = 12345;
+    unsigned short info_port = 12346;
+    double rate = 4;            // market data steps per second
+    int speed = 1;              // exchange clock speed-up, shortens the frequency window
+    double volatility = 50;     // standard deviation of one price step, in cents
+    double flow = 0.5;          // chance of a taker trade per side, instrument and step
+    unsigned seed = 1;
+    double duration = 60;       // seconds to run
+    bool strict = false;
+};
+
+struct Book {
+    Levels askPrices{}, askVolumes{}, bidPrices{}, bidVolumes{};
+};
+
+// One aggressive order from the synthetic crowd, good up to limit.
+struct Aggressor {
+    bool active = false;
+    unsigned long limit = 0, volume = 0;
+};
+
+// Volume traded per price over one step, split by the aggressor's side.
+struct Trades {
+    std::map<unsigned long, unsigned long> asks, bids;   // buyer- and seller-initiated
+
+    void clear() { asks.clear(); bids.clear(); }
+};
+
+class SyntheticMarket {
+public:
+    explicit SyntheticMarket(const Options& o)
+        : rng(o.seed), move(0.0, o.volatility), flow(o.flow) {}
+
+    void step() {
+        fair = std::max(fair + move(rng), 20.0 * TICK);
+        build(books[size_t(Instrument::FUTURE)], fair);
+        build(books[size_t(Instrument::ETF)], fair + double(TICK) * std::uniform_int_distribution<int>(-1, 1)(rng));
+        for(size_t i=0;i<2;i++){
+            const Book& b = books[i];
+            buys[i] = aggressor(b.askPrices[0], +1);
+            sells[i] = aggressor(b.bidPrices[0], -1);
+        }
+    }
+
+    Book& book(Instrument instrument) { return books[size_t(instrument)]; }
+    const Aggressor& buy(Instrument instrument) const { return buys[size_t(instrument)]; }
+    const Aggressor& sell(Instrument instrument) const { return sells[size_t(instrument)]; }
+    double mid(Instrument instrument) const {
+        const Book& b = books[size_t(instrument)];
+        return (b.askPrices[0] + b.bidPrices[0]) / 2.0;
+    }
+
+private:
+    void build(Book& b, double mid) {
+        unsigned long m = (unsigned long)(mid / TICK) * TICK;
+        std::uniform_int_distribution<unsigned long> volume(20, 300);
+        for(size_t k=0;k<TOP_LEVEL_COUNT;k++){
+            b.askPrices[k] = m + (k + 1) * TICK;
+            b.bidPrices[k] = m - k * TICK;
+            b.askVolumes[k] = volume(rng);
+            b.bidVolumes[k] = volume(rng);
+        }
+    }
+
+    Aggressor aggressor(unsigned long best, int direction) {
+        Aggressor a;
+        if(std::uniform_real_distribution<double>(0, 1)(rng) >= flow) return a;
+        a.active = true;
+        a.limit = best + direction * long(TICK) * std::uniform_int_distribution<int>(0, 2)(rng);
+        a.volume = std::uniform_int_distribution<unsigned long>(1, 200)(rng);
+        return a;
+    }
+
+    std::mt19937_64 rng;
+    std::normal_distribution<double> move;
+    double flow;
+    double fair = 1000 * TICK;
+    std::array<Book, 2> books;
+    std::array<Aggressor, 2> buys, sells;
+};
+
+struct Resting {
+    Side side;
+    unsigned long price, volume, filled;
+    long fees;
+};
+
+struct ExchangeStats {
+    unsigned long received[12] = {};
+    unsigned long sent = 0, published = 0;
+    unsigned long fills = 0, hedges = 0, errors = 0, breaches = 0;
+    size_t busiest = 0;                  // most messages in one frequency window
+    std::vector<long long> round_trip;   // book published to next order message, ns
+};
+
+class LoopbackExchange {
+public:
+    LoopbackExchange(boost::asio::io_context& context, const Options& o)
+        : options(o), market(o), acceptor(context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), o.exec_port)),
+          socket(context), info(context, udp::v4()), info_to(boost::asio::ip::address_v4::loopback(), o.info_port),
+          ticker(context), window(MESSAGE_WINDOW / o.speed) {
+        market.step();
+        accept();
+        tick();
+    }
+
+    void report() const;
+
+private:
+    void accept();
+    void read_header();
+    void read_body(size_t size);
+    void handle();
+    void login();
+    void insert(unsigned long id, Side side, unsigned long price, unsigned long volume, Lifespan lifespan);
+    void amend(unsigned long id, unsigned long volume);
+    void cancel(unsigned long id);
+    void hedge(unsigned long id, Side side, unsigned long price, unsigned long volume);
+    void tick();
+    void publish(Instrument instrument, Trades& trades);
+    void take_etf(Side takerSide, const Aggressor& a);
+    void fill(unsigned long id, Resting& o, unsigned long price, unsigned long volume, bool maker);
+    void status(unsigned long id, const Resting& o);
+    bool admit();
+    void error(unsigned long id, const char* text, bool breach);
+    void send(const unsigned char* message, size_t size);
+    void flush();
+    void close();
+
+    Options options;
+    SyntheticMarket market;
+    tcp::acceptor acceptor;
+    tcp::socket socket;
+    udp::socket info;
+    udp::endpoint info_to;
+    boost::asio::steady_timer ticker;
+
+    bool connected = false, logged_in = false, writing = false;
+    unsigned char in[WIRE_MAX_SIZE];
+    std::vector<unsigned char> out, in_flight;
+
+    std::map<unsigned long, Resting> orders;
+    Trades trades[2];
+    unsigned long sequence[2] = {}, tick_sequence[2] = {};
+    long etf_position = 0, future_position = 0;
+    long long cash = 0;
+
+    long long window;
+    std::deque<long long> recent;
+    long long last_publish = 0;
+    bool awaiting = false;
+
+    ExchangeStats stats;
+};
+
+void LoopbackExchange::accept()
+{
+    acceptor.async_accept(socket, [this](const boost::system::error_code& error){
+        if(error) return;
+        socket.set_option(tcp::no_delay(true));
+        connected = true;
+        logged_in = false;
+        std::printf("trader connected\n");
+        read_header();
+    });
+}
+
+void LoopbackExchange::read_header()
+{
+    boost::asio::async_read(socket, boost::asio::buffer(in, WIRE_HEADER_SIZE),
+                            [this](const boost::system::error_code& error, size_t){
+        if(error) return close();
+        size_t size = wire_length(in);
+        if(size <= WIRE_HEADER_SIZE || size > sizeof(in)) {
+            std::printf("malformed message header\n");
+            return close();
+        }
+        read_body(size);
+    });
+}
+
+void LoopbackExchange::read_body(size_t size)
+{
+    boost::asio::async_read(socket, boost::asio::buffer(in + WIRE_HEADER_SIZE, size - WIRE_HEADER_SIZE),
+                            [this](const boost::system::error_code& error, size_t){
+        if(error) return close();
+        handle();
+        if(connected) read_header();
+    });
+}
+
+void LoopbackExchange::handle()
+{
+    WireType type = wire_type(in);
+    size_t size = wire_length(in);
+    if(size_t(type) < 12) stats.received[size_t(type)]++;
+
+    if(type == WireType::LOGIN && size == WIRE_LOGIN_SIZE) return login();
+    if(!logged_in) return error(0, "not logged in", true);
+
+    if(awaiting) {
+        stats.round_trip.push_back(real_clock().now() - last_publish);
+        awaiting = false;
+    }
+    if(!admit()) return;
+
+    switch(type) {
+    case WireType::INSERT_ORDER:
+        if(size != WIRE_INSERT_SIZE) break;
+        return insert(wire_get32(in + 3), Side(wire_get8(in + 7)), wire_get32(in + 8), wire_get32(in + 12), Lifespan(wire_get8(in + 16)));
+    case WireType::AMEND_ORDER:
+        if(size != WIRE_AMEND_SIZE) break;
+        return amend(wire_get32(in + 3), wire_get32(in + 7));
+    case WireType::CANCEL_ORDER:
+        if(size != WIRE_CANCEL_SIZE) break;
+        return cancel(wire_get32(in + 3));
+    case WireType::HEDGE_ORDER:
+        if(size != WIRE_HEDGE_ORDER_SIZE) break;
+        return hedge(wire_get32(in + 3), Side(wire_get8(in + 7)), wire_get32(in + 8), wire_get32(in + 12));
+    default:
+        break;
+    }
+    error(0, "unexpected message", false);
+}
+
+void LoopbackExchange::login()
+{
+    char name[WIRE_LOGIN_FIELD + 1] = {};
+    std::memcpy(name, in + 3, WIRE_LOGIN_FIELD);
+    std::printf("login from %s\n", name);
+    logged_in = true;
+}
+
+// Counts the message against the sliding frequency window.
+bool LoopbackExchange::admit()
+{
+    long long now = real_clock().now();
+    while(!recent.empty() && recent.front() <= now - window) recent.pop_front();
+    recent.push_back(now);
+    stats.busiest = std::max(stats.busiest, recent.size());
+    if(recent.size() <= MESSAGE_LIMIT) return true;
+    error(0, "message frequency limit breached", true);
+    return !options.strict;
+}
+
+void LoopbackExchange::insert(unsigned long id, Side side, unsigned long price, unsigned long volume, Lifespan lifespan)
+{
+    if(orders.count(id)) return error(id, "duplicate order id", false);
+    if(volume == 0 || price == 0 || price % TICK) return error(id, "invalid price or volume", false);
+    if(orders.size() >= ACTIVE_ORDER_LIMIT) return error(id, "active order limit breached", true);
+
+    unsigned long active = 0;
+    for(auto& o: orders) if(o.second.side == side) active += o.second.volume - o.second.filled;
+    if(active + volume > ACTIVE_VOLUME_LIMIT) return error(id, "active volume limit breached", true);
+    long exposure = side == Side::BUY ? etf_position + long(active + volume) : etf_position - long(active + volume);
+    if(std::labs(exposure) > POSITION_LIMIT) return error(id, "position limit breached", true);
+
+    Resting& o = orders[id] = Resting{side, price, volume, 0, 0};
+
+    // Cross the synthetic book first, best price first.
+    Book& b = market.book(Instrument::ETF);
+    Levels& prices = side == Side::BUY ? b.askPrices : b.bidPrices;
+    Levels& volumes = side == Side::BUY ? b.askVolumes : b.bidVolumes;
+    auto& traded = side == Side::BUY ? trades[size_t(Instrument::ETF)].asks : trades[size_t(Instrument::ETF)].bids;
+    for(size_t k=0;k<TOP_LEVEL_COUNT && o.filled < o.volume;k++){
+        bool crosses = side == Side::BUY ? prices[k] <= price : prices[k] >= price;
+        if(!crosses || volumes[k] == 0) break;
+        unsigned long v = std::min(volumes[k], o.volume - o.filled);
+        volumes[k] -= v;
+        traded[prices[k]] += v;
+        fill(id, o, prices[k], v, false);
+    }
+
+    status(id, o);
+    if(o.filled == o.volume || lifespan == Lifespan::FILL_AND_KILL) orders.erase(id);
+}
+
+void LoopbackExchange::amend(unsigned long id, unsigned long volume)
+{
+    auto it = orders.find(id);
+    if(it == orders.end()) return;
+    Resting& o = it->second;
+    if(volume > o.volume) return error(id, "amend may only reduce volume", false);
+    o.volume = std::max(volume, o.filled);
+    status(id, o);
+    if(o.filled == o.volume) orders.erase(it);
+}
+
+void LoopbackExchange::cancel(unsigned long id)
+{
+    auto it = orders.find(id);
+    if(it == orders.end()) return;
+    it->second.volume = it->second.filled;
+    status(id, it->second);
+    orders.erase(it);
+}
+
+// Hedges fill immediately against the future book up to the limit price;
+// whatever is left is cancelled.
+void LoopbackExchange::hedge(unsigned long id, Side side, unsigned long price, unsigned long volume)
+{
+    stats.hedges++;
+    Book& b = market.book(Instrument::FUTURE);
+    Levels& prices = side == Side::BUY ? b.askPrices : b.bidPrices;
+    Levels& volumes = side == Side::BUY ? b.askVolumes : b.bidVolumes;
+    unsigned long filled = 0;
+    unsigned long long notional = 0;
+    for(size_t k=0;k<TOP_LEVEL_COUNT && filled < volume;k++){
+        bool crosses = side == Side::BUY ? prices[k] <= price : prices[k] >= price;
+        if(!crosses) break;
+        unsigned long v = std::min(volumes[k], volume - filled);
+        volumes[k] -= v;
+        filled += v;
+        notional += (unsigned long long)prices[k] * v;
+    }
+
+    unsigned long average = filled ? (unsigned long)((notional + filled / 2) / filled) : 0;
+    if(side == Side::BUY) { future_position += filled; cash -= notional; }
+    else { future_position -= filled; cash += notional; }
+
+    unsigned char m[WIRE_MAX_SIZE];
+    send(m, wire_hedge_filled(m, id, average, filled));
+}
+
+void LoopbackExchange::fill(unsigned long id, Resting& o, unsigned long price, unsigned long volume, bool maker)
+{
+    o.filled += volume;
+    long notional = long(price * volume);
+    long fee = maker ? -notional / 10000 : notional * 2 / 10000;
+    o.fees += fee;
+    cash -= fee;
+    if(o.side == Side::BUY) { etf_position += volume; cash -= notional; }
+    else { etf_position -= volume; cash += notional; }
+    stats.fills++;
+
+    unsigned char m[WIRE_MAX_SIZE];
+    send(m, wire_order_filled(m, id, price, volume));
+}
+
+void LoopbackExchange::status(unsigned long id, const Resting& o)
+{
+    unsigned char m[WIRE_MAX_SIZE];
+    send(m, wire_order_status(m, id, o.filled, o.volume - o.filled, o.fees));
+}
+
+// A synthetic taker sweeps the ETF book up to its limit. At each price the
+// crowd's resting volume trades first and the trader's orders after it, in
+// the order they were inserted.
+void LoopbackExchange::take_etf(Side takerSide, const Aggressor& a)
+{
+    if(!a.active) return;
+    Book& b = market.book(Instrument::ETF);
+    bool buying = takerSide == Side::BUY;
+    Levels& prices = buying ? b.askPrices : b.bidPrices;
+    Levels& volumes = buying ? b.askVolumes : b.bidVolumes;
+    auto& traded = buying ? trades[size_t(Instrument::ETF)].asks : trades[size_t(Instrument::ETF)].bids;
+
+    unsigned long price = prices[0];
+    for(auto& o: orders)
+        if(o.second.side != takerSide) price = buying ? std::min(price, o.second.price) : std::max(price, o.second.price);
+
+    unsigned long left = a.volume;
+    for(; left && (buying ? price <= a.limit : price >= a.limit); price = buying ? price + TICK : price - TICK){
+        for(size_t k=0;k<TOP_LEVEL_COUNT && left;k++){
+            if(prices[k] != price) continue;
+            unsigned long v = std::min(volumes[k], left);
+            volumes[k] -= v;
+            left -= v;
+            traded[price] += v;
+        }
+        for(auto it = orders.begin(); it != orders.end() && left;){
+            Resting& o = it->second;
+            if(o.side == takerSide || o.price != price) { ++it; continue; }
+            unsigned long v = std::min(o.volume - o.filled, left);
+            left -= v;
+            traded[price] += v;
+            fill(it->first, o, price, v, true);
+            status(it->first, o);
+            if(o.filled == o.volume) it = orders.erase(it);
+            else ++it;
+        }
+        if(price < TICK) break;
+    }
+}
+
+void LoopbackExchange::tick()
+{
+    ticker.expires_after(std::chrono::nanoseconds((long long)(1e9 / options.rate)));
+    ticker.async_wait([this](const boost::system::error_code& error){
+        if(error) return;
+        market.step();
+
+        // Future takers only leave trade ticks behind.
+        for(Side s: {Side::BUY, Side::SELL}){
+            const Aggressor& a = s == Side::BUY ? market.buy(Instrument::FUTURE) : market.sell(Instrument::FUTURE);
+            if(!a.active) continue;
+            const Book& b = market.book(Instrument::FUTURE);
+            auto& traded = s == Side::BUY ? trades[size_t(Instrument::FUTURE)].asks : trades[size_t(Instrument::FUTURE)].bids;
+            traded[s == Side::BUY ? b.askPrices[0] : b.bidPrices[0]] += a.volume;
+        }
+        take_etf(Side::BUY, market.buy(Instrument::ETF));
+        take_etf(Side::SELL, market.sell(Instrument::ETF));
+
+        publish(Instrument::FUTURE, trades[size_t(Instrument::FUTURE)]);
+        publish(Instrument::ETF, trades[size_t(Instrument::ETF)]);
+        last_publish = real_clock().now();
+        awaiting = logged_in;
+        tick();
+    });
+}
+
+void LoopbackExchange::publish(Instrument instrument, Trades& t)
+{
+    unsigned char m[WIRE_MAX_SIZE];
+    const Book& b = market.book(instrument);
+    size_t size = wire_book(m, WireType::ORDER_BOOK_UPDATE, instrument, ++sequence[size_t(instrument)],
+                            b.askPrices, b.askVolumes, b.bidPrices, b.bidVolumes);
+    boost::system::error_code ignored;
+    info.send_to(boost::asio::buffer(m, size), info_to, 0, ignored);
+    stats.published++;
+
+    if(t.asks.empty() && t.bids.empty()) return;
+    Levels ap{}, av{}, bp{}, bv{};
+    size_t k = 0;
+    for(auto it = t.asks.begin(); it != t.asks.end() && k < TOP_LEVEL_COUNT; ++it, ++k) { ap[k] = it->first; av[k] = it->second; }
+    k = 0;
+    for(auto it = t.bids.rbegin(); it != t.bids.rend() && k < TOP_LEVEL_COUNT; ++it, ++k) { bp[k] = it->first; bv[k] = it->second; }
+    size = wire_book(m, WireType::TRADE_TICKS, instrument, ++tick_sequence[size_t(instrument)], ap, av, bp, bv);
+    info.send_to(boost::asio::buffer(m, size), info_to, 0, ignored);
+    stats.published++;
+    t.clear();
+}
+
+void LoopbackExchange::error(unsigned long id, const char* text, bool breach)
+{
+    stats.errors++;
+    if(breach) stats.breaches++;
+    unsigned char m[WIRE_MAX_SIZE];
+    send(m, wire_error(m, id, text));
+    if(breach && options.strict) close();
+}
+
+void LoopbackExchange::send(const unsigned char* message, size_t size)
+{
+    if(!connected) return;
+    stats.sent++;
+    out.insert(out.end(), message, message + size);
+    if(!writing) flush();
+}
+
+void LoopbackExchange::flush()
+{
+    if(out.empty() || !connected) { writing = false; return; }
+    writing = true;
+    in_flight.swap(out);
+    out.clear();
+    boost::asio::async_write(socket, boost::asio::buffer(in_flight), [this](const boost::system::error_code& error, size_t){
+        if(error) return close();
+        flush();
+    });
+}
+
+void LoopbackExchange::close()
+{
+    if(!connected) return;
+    connected = false;
+    writing = false;
+    out.clear();
+    boost::system::error_code ignored;
+    socket.shutdown(tcp::socket::shutdown_both, ignored);
+    socket.close(ignored);
+    orders.clear();
+    std::printf("trader disconnected\n");
+    accept();
+}
+
+void LoopbackExchange::report() const
+{
+    static const char* names[] = {"?", "amend", "cancel", "error", "hedge filled", "hedge", "insert",
+                                  "login", "filled", "status", "book", "ticks"};
+    std::printf("received:");
+    for(size_t t=1;t<12;t++) if(stats.received[t]) std::printf(" %s %lu", names[t], stats.received[t]);
+    std::printf("\nsent %lu execution messages, published %lu market data messages\n", stats.sent, stats.published);
+    std::printf("%lu fills, %lu hedges, %lu errors, %lu limit breaches\n", stats.fills, stats.hedges, stats.errors, stats.breaches);
+    std::printf("busiest frequency window: %zu of %zu messages\n", stats.busiest, MESSAGE_LIMIT);
+
+    std::vector<long long> rt = stats.round_trip;
+    if(!rt.empty()){
+        std::sort(rt.begin(), rt.end());
+        std::printf("book to order round trip over %zu reactions: p50 %lld ns, p99 %lld ns, max %lld ns\n", rt.size(),
+                    rt[rt.size() / 2], rt[rt.size() * 99 / 100], rt.back());
+    }
+
+    double mark = cash + etf_position * market.mid(Instrument::ETF) + future_position * market.mid(Instrument::FUTURE);
+    std::printf("trader position etf %ld future %ld, pnl %.0f\n", etf_position, future_position, mark);
+}
+
+// A whole decimal number in [lo, hi], and nothing after it.
+static bool parse_long(const char* p, long lo, long hi, long& out)
+{
+    char* end;
+    errno = 0;
+    long v = std::strtol(p, &end, 10);
+    if(end == p || errno || *end || v < lo || v > hi) return false;
+    out = v;
+    return true;
+}
+
+// A number in [lo, hi], and nothing after it. NaN is never in range.
+static bool parse_double(const char* p, double lo, double hi, double& out)
+{
+    char* end;
+    errno = 0;
+    double v = std::strtod(p, &end);
+    if(end == p || errno || *end || !(v >= lo && v <= hi)) return false;
+    out = v;
+    return true;
+}
+
+static int usage(const char* argv0)
+{
+    std::fprintf(stderr, "usage: %s [--exec-port N] [--info-port N] [--rate STEPS_PER_S] [--speed N] "
+                         "[--volatility CENTS] [--flow P] [--seed N] [--duration S] [--strict]\n", argv0);
+    std::fprintf(stderr, "where\n"
+                         "    --exec-port, --info-port  1 .. 65535\n"
+                         "    --rate                    0.001 .. 1000000\n"
+                         "    --speed                   1 .. 1000\n"
+                         "    --volatility              0.01 .. 1000000\n"
+                         "    --flow                    0 .. 1\n"
+                         "    --seed                    0 .. 4294967295\n"
+                         "    --duration                0.001 .. 1000000\n");
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    Options o;
+    for(int i=1;i<argc;i++){
+        const char* a = argv[i];
+        if(std::strcmp(a, "--strict") == 0) { o.strict = true; continue; }
+        const char* v = i + 1 < argc ? argv[++i] : "";
+        long n = 0;
+        bool ok;
+        if(std::strcmp(a, "--exec-port") == 0) { ok = parse_long(v, 1, 65535, n); o.exec_port = (unsigned short)n; }
+        else if(std::strcmp(a, "--info-port") == 0) { ok = parse_long(v, 1, 65535, n); o.info_port = (unsigned short)n; }
+        else if(std::strcmp(a, "--rate") == 0) ok = parse_double(v, 0.001, 1e6, o.rate);
+        else if(std::strcmp(a, "--speed") == 0) { ok = parse_long(v, 1, 1000, n); o.speed = int(n); }
+        else if(std::strcmp(a, "--volatility") == 0) ok = parse_double(v, 0.01, 1e6, o.volatility);
+        else if(std::strcmp(a, "--flow") == 0) ok = parse_double(v, 0, 1, o.flow);
+        else if(std::strcmp(a, "--seed") == 0) { ok = parse_long(v, 0, 4294967295L, n); o.seed = unsigned(n); }
+        else if(std::strcmp(a, "--duration") == 0) ok = parse_double(v, 0.001, 1e6, o.duration);
+        else {
+            std::fprintf(stderr, "unknown option %s\n", a);
+            return usage(argv[0]);
+        }
+        if(!ok){
+            std::fprintf(stderr, "bad value '%s' for %s\n", v, a);
+            return usage(argv[0]);
+        }
+    }
+
+    boost::asio::io_context context;
+    LoopbackExchange exchange(context, o);
+
+    boost::asio::steady_timer stop(context);
+    stop.expires_after(std::chrono::nanoseconds((long long)(o.duration * 1e9)));
+    stop.async_wait([&context](const boost::system::error_code& error){ if(!error) context.stop(); });
+    boost::asio::signal_set signals(context, SIGINT, SIGTERM);
+    signals.async_wait([&context](const boost::system::error_code&, int){ context.stop(); });
+
+    std::printf("execution on 127.0.0.1:%u, market data to 127.0.0.1:%u, %.0f steps/s\n", o.exec_port, o.info_port, o.rate);
+    context.run();
+    exchange.report();
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_LOWLATENCY_H
+#define CPPREADY_TRADER_GO_LOWLATENCY_H
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+// Settings for running the trading thread as a busy-polling, pinned thread.
+// They are given as a comma separated list, e.g.
+//     cpu=3,aux=0-2,fifo=50,mlock,prefault=64
+// cpu       pin the trading thread to this CPU (default: leave it floating)
+// aux       CPUs for the logger and tracer threads (default: all but cpu)
+// fifo      run the trading thread under SCHED_FIFO at this priority
+// mlock     lock all current and future pages in memory
+// prefault  fault in this many MB of heap and the thread's stack up front
+struct LowLatencyConfig {
+    int cpu = -1;
+    cpu_set_t aux;
+    bool aux_given = false;
+    int fifo = 0;
+    bool mlock = false;
+    size_t prefault_mb = 0;
+
+    // Returns false, and names the offending item in error, on a bad list.
+    bool parse(const char* spec, std::string& error) {
+        CPU_ZERO(&aux);
+        std::string s(spec);
+        size_t start = 0;
+        while(start <= s.size()){
+            size_t end = s.find(',', start);
+            if(end == std::string::npos) end = s.size();
+            std::string item = s.substr(start, end - start);
+            start = end + 1;
+            if(item.empty()) continue;
+
+            size_t eq = item.find('=');
+            std::string key = item.substr(0, eq), value = eq == std::string::npos ? "" : item.substr(eq + 1);
+            if(key == "cpu" && !value.empty()) cpu = std::atoi(value.c_str());
+            else if(key == "aux" && parse_cpus(value)) aux_given = true;
+            else if(key == "fifo" && !value.empty()) fifo = std::atoi(value.c_str());
+            else if(key == "mlock" && value.empty()) mlock = true;
+            else if(key == "prefault" && !value.empty()) prefault_mb = std::strtoul(value.c_str(), nullptr, 10);
+            else {
+                error = item;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The CPUs auxiliary threads may use: aux if given, otherwise every CPU
+    // the process may run on except the trading one.
+    cpu_set_t aux_cpus() const {
+        if(aux_given) return aux;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        if(cpu >= 0 && CPU_COUNT(&set) > 1) CPU_CLR(cpu, &set);
+        return set;
+    }
+
+private:
+    // Accepts "0-2,5" style lists, with '+' standing in for ',' since the
+    // list itself is comma separated: aux=0-2+5.
+    bool parse_cpus(const std::string& list) {
+        if(list.empty()) return false;
+        size_t start = 0;
+        while(start <= list.size()){
+            size_t end = list.find('+', start);
+            if(end == std::string::npos) end = list.size();
+            std::string range = list.substr(start, end - start);
+            start = end + 1;
+            size_t dash = range.find('-');
+            int lo = std::atoi(range.c_str());
+            int hi = dash == std::string::npos ? lo : std::atoi(range.c_str() + dash + 1);
+            if(lo < 0 || hi < lo || hi >= CPU_SETSIZE) return false;
+            for(int c=lo;c<=hi;c++) CPU_SET(c, &aux);
+        }
+        return true;
+    }
+};
+
+inline bool pin_thread(pthread_t thread, const cpu_set_t& cpus) {
+    return pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0;
+}
+
+inline bool pin_thread(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pin_thread(thread, set);
+}
+
+inline bool set_fifo(pthread_t thread, int priority) {
+    sched_param param{};
+    param.sched_priority = priority;
+    return pthread_setschedparam(thread, SCHED_FIFO, &param) == 0;
+}
+
+// Keeps freed heap memory in the process and touches it once, so neither the
+// heap nor the first stack_kb of the calling thread's stack page faults
+// later.
+inline void prefault(size_t heap_mb, size_t stack_kb = 512) {
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if(heap_mb) {
+        size_t bytes = heap_mb << 20;
+        if(char* p = static_cast<char*>(std::malloc(bytes))) {
+            for(size_t i=0;i<bytes;i+=4096) static_cast<volatile char*>(p)[i] = 0;
+            std::free(p);
+        }
+    }
+    volatile char* stack = static_cast<volatile char*>(alloca(stack_kb << 10));
+    for(size_t i=0;i<(stack_kb << 10);i+=4096) stack[i] = 0;
+}
+
+#endif //CPPREADY_TRADER_GO_LOWLATENCY_H
@@ -0,0 +1,176 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_MICROSTRUCTURE_H
+#define CPPREADY_TRADER_GO_MICROSTRUCTURE_H
+
+#include <algorithm>
+#include <array>
+
+#include <ready_trader_go/types.h>
+
+// Microstructure features of both instruments, updated message by message.
+// Rolling sums live in fixed rings and only see the value entering and the
+// one leaving, and averages are exponential with a power-of-two weight, so
+// each update is O(1) and nothing is rescanned or allocated. Everything is
+// integer so replays reproduce bit for bit.
+
+// Averages and the microprice carry FRAC_BITS fractional bits of a cent.
+constexpr int FRAC_BITS = 8;
+
+struct alignas(64) InstrumentFeatures {
+    // Top of the latest book.
+    long long ask = 0, bid = 0, ask_volume = 0, bid_volume = 0;
+    long long micro = 0;          // touch prices weighted by the opposite volume
+    long long ewma_mid = 0, ewma_micro = 0;
+    // Order-flow imbalance (Cont, Kukanov and Stoikov) over the last Window
+    // books: volume arriving at or improving the bid minus the same at the ask.
+    long long ofi = 0;
+    // Volume traded over the last Window trade tick messages, by distance in
+    // ticks from the touch the trade hit; ask side is buyer-initiated.
+    std::array<long long, ReadyTraderGo::TOP_LEVEL_COUNT> traded_ask{}, traded_bid{};
+    long long buy_volume = 0, sell_volume = 0;
+    unsigned long books = 0, ticks = 0;
+
+    bool ready() const { return ask != 0 && bid != 0; }
+    long long mid() const { return (ask + bid) << (FRAC_BITS - 1); }
+};
+
+struct Features {
+    std::array<InstrumentFeatures, 2> instruments;
+    long long basis = 0, ewma_basis = 0;     // ETF mid minus future mid
+
+    const InstrumentFeatures& operator[](ReadyTraderGo::Instrument i) const { return instruments[size_t(i)]; }
+};
+
+template<size_t Window>
+class RollingSum {
+public:
+    // Adds v and drops the value pushed Window calls ago; returns the change.
+    long long push(long long v) {
+        long long delta = v - ring[head];
+        ring[head] = v;
+        head = head + 1 == Window ? 0 : head + 1;
+        return delta;
+    }
+
+private:
+    std::array<long long, Window> ring{};
+    size_t head = 0;
+};
+
+// Shift sets the averages' weight on a new value to 1 / 2^Shift.
+template<size_t Window = 32, int Shift = 3>
+class FeatureEngine {
+public:
+    explicit FeatureEngine(long long tick = 100) : tick(tick) {}
+
+    const Features& get() const { return features; }
+
+    // Out-of-order and duplicate messages are ignored, like the conflator does.
+    void book(ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) {
+        State& s = state[size_t(instrument)];
+        if(!fresh(s.book_sequence, sequenceNumber)) return;
+        if(askPrices[0] == 0 || bidPrices[0] == 0) return;
+        InstrumentFeatures& f = features.instruments[size_t(instrument)];
+
+        long long ask = askPrices[0], bid = bidPrices[0];
+        long long av = askVolumes[0], bv = bidVolumes[0];
+        if(f.ready()) {
+            long long e = 0;
+            if(bid >= f.bid) e += bv;
+            if(bid <= f.bid) e -= f.bid_volume;
+            if(ask <= f.ask) e -= av;
+            if(ask >= f.ask) e += f.ask_volume;
+            f.ofi += s.ofi.push(e);
+        }
+        bool first = !f.ready();
+        f.ask = ask;
+        f.bid = bid;
+        f.ask_volume = av;
+        f.bid_volume = bv;
+        f.micro = av + bv ? ((ask * bv + bid * av) << FRAC_BITS) / (av + bv) : f.mid();
+        average(f.ewma_mid, f.mid(), first);
+        average(f.ewma_micro, f.micro, first);
+        f.books++;
+
+        const InstrumentFeatures& fut = features[ReadyTraderGo::Instrument::FUTURE];
+        const InstrumentFeatures& etf = features[ReadyTraderGo::Instrument::ETF];
+        if(fut.ready() && etf.ready()) {
+            features.basis = etf.mid() - fut.mid();
+            average(features.ewma_basis, features.basis, !basis_ready);
+            basis_ready = true;
+        }
+    }
+
+    void ticks(ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+               const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) {
+        State& s = state[size_t(instrument)];
+        if(!fresh(s.tick_sequence, sequenceNumber)) return;
+        InstrumentFeatures& f = features.instruments[size_t(instrument)];
+
+        std::array<long long, ReadyTraderGo::TOP_LEVEL_COUNT> asks{}, bids{};
+        for(size_t i=0;i<ReadyTraderGo::TOP_LEVEL_COUNT;i++){
+            if(askVolumes[i]) asks[f.ready() ? level((long long)askPrices[i] - f.ask) : i] += askVolumes[i];
+            if(bidVolumes[i]) bids[f.ready() ? level(f.bid - (long long)bidPrices[i]) : i] += bidVolumes[i];
+        }
+        for(size_t k=0;k<ReadyTraderGo::TOP_LEVEL_COUNT;k++){
+            long long da = s.traded_ask[k].push(asks[k]), db = s.traded_bid[k].push(bids[k]);
+            f.traded_ask[k] += da;
+            f.traded_bid[k] += db;
+            f.buy_volume += da;
+            f.sell_volume += db;
+        }
+        f.ticks++;
+    }
+
+private:
+    struct State {
+        unsigned long book_sequence = 0, tick_sequence = 0;
+        RollingSum<Window> ofi;
+        std::array<RollingSum<Window>, ReadyTraderGo::TOP_LEVEL_COUNT> traded_ask, traded_bid;
+    };
+
+    static bool fresh(unsigned long& last, unsigned long sequenceNumber) {
+        if(last != 0 && sequenceNumber <= last) return false;
+        last = sequenceNumber;
+        return true;
+    }
+
+    static void average(long long& avg, long long v, bool first) {
+        avg = first ? v : avg + ((v - avg) >> Shift);
+    }
+
+    // Ticks beyond the touch, with trades inside it counted at the touch.
+    size_t level(long long distance) const {
+        return size_t(std::min<long long>(std::max<long long>(distance / tick, 0), ReadyTraderGo::TOP_LEVEL_COUNT - 1));
+    }
+
+    long long tick;
+    bool basis_ready = false;
+    Features features;
+    std::array<State, 2> state;
+};
+
+#endif //CPPREADY_TRADER_GO_MICROSTRUCTURE_H
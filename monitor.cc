@@ -0,0 +1,89 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Watches the state a trader publishes with AUTOTRADER_MONITOR=<name>:
+//     monitor <name> [--interval ms] [--once]
+// It only ever reads the shared memory, so it can be started, stopped and
+// restarted at any time without affecting the trader.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "monitor.h"
+
+static void print(const StrategySnapshot& s)
+{
+    std::printf("t=%.3fs #%llu pos=%d hedge=%d/%d%s theo=%d (fut %d etf %d) etf=%d/%d",
+                s.time / 1e9, (unsigned long long)s.updates, s.position, s.current_hedge, s.target_hedge,
+                s.hedge_in_flight ? "*" : "", s.theo, s.theo_fut, s.theo_etf, s.etf_bid, s.etf_ask);
+    std::printf(" bids");
+    for(int i=0;i<s.bids && i<MONITOR_LEVELS;i++) std::printf(" %dx%d", s.bid[i].size, s.bid[i].price);
+    std::printf(" asks");
+    for(int i=0;i<s.asks && i<MONITOR_LEVELS;i++) std::printf(" %dx%d", s.ask[i].size, s.ask[i].price);
+    std::printf(" live=%d free=%d sent", s.live_orders, s.window_free);
+    for(int p=0;p<MONITOR_CLASSES;p++) std::printf("%c%llu", p ? '/' : ' ', (unsigned long long)s.sent[p]);
+    std::printf(" denied");
+    for(int p=0;p<MONITOR_CLASSES;p++) std::printf("%c%llu", p ? '/' : ' ', (unsigned long long)s.denied[p]);
+    std::printf(" ofi=%lld basis=%.2f fut_sd=%.0f probes=%llu/%llu%s\n", (long long)s.etf_ofi, s.basis / 256.0 /* FRAC_BITS */,
+                std::sqrt(double(s.future_var)), (unsigned long long)s.probes_wanted, (unsigned long long)s.probes_fixed,
+                s.started ? "" : " (not started)");
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* name = nullptr;
+    int interval = 1000;
+    bool once = false, bad = false;
+    for(int i=1;i<argc;i++){
+        if(!std::strcmp(argv[i], "--interval") && i + 1 < argc) interval = std::atoi(argv[++i]);
+        else if(!std::strcmp(argv[i], "--once")) once = true;
+        else if(argv[i][0] != '-' && !name) name = argv[i];
+        else bad = true;
+    }
+    if(bad || !name || interval <= 0){
+        std::fprintf(stderr, "usage: %s <name> [--interval ms] [--once]\n", argv[0]);
+        return 1;
+    }
+
+    MonitorReader reader(name);
+    if(!reader.ok()){
+        std::fprintf(stderr, "no trader state at %s\n", monitor_name(name).c_str());
+        return 1;
+    }
+
+    StrategySnapshot s;
+    uint64_t last = ~0ULL;
+    for(;;){
+        // A writer preempted halfway through an update holds the sequence odd
+        // until it runs again, so give up the CPU between attempts.
+        bool got = false;
+        for(int i=0;i<100 && !(got = reader.read(s));i++) std::this_thread::yield();
+        if(!got) std::fprintf(stderr, "no consistent snapshot, writer too busy\n");
+        else if(s.updates != last || once){
+            print(s);
+            last = s.updates;
+        }
+        if(once) return 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+    }
+}
@@ -0,0 +1,164 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_MONITOR_H
+#define CPPREADY_TRADER_GO_MONITOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The strategy's state, published into POSIX shared memory after every
+// callback so another process can watch it. Access is a seqlock: the writer
+// makes the sequence odd, updates the snapshot in place and makes it even
+// again, and a reader retries until it copied the snapshot between two equal
+// even reads. The trading thread never waits for, or even notices, a reader.
+
+constexpr uint32_t MONITOR_MAGIC = 0x52544753;   // "RTGS"
+constexpr uint32_t MONITOR_VERSION = 2;
+constexpr int MONITOR_LEVELS = 4;
+constexpr int MONITOR_CLASSES = 4;               // message priority classes
+
+struct MonitorLevel {
+    int32_t price, size;
+};
+
+struct StrategySnapshot {
+    int64_t time;                  // strategy clock, ns
+    uint64_t updates;
+    int32_t position, current_hedge, target_hedge;
+    int32_t theo, theo_fut, theo_etf, etf_ask, etf_bid;
+    int32_t asks, bids;            // resting quotes on each side
+    MonitorLevel ask[MONITOR_LEVELS], bid[MONITOR_LEVELS];
+    int32_t window_free;           // messages the frequency limiter would still admit
+    int32_t live_orders;
+    int32_t hedge_in_flight;
+    int32_t started;
+    uint64_t sent[MONITOR_CLASSES], denied[MONITOR_CLASSES];
+    int64_t etf_ofi, basis;        // basis in cents << FRAC_BITS
+    int64_t future_var;            // uncertainty of theo_fut, cents^2
+    uint64_t probes_wanted, probes_fixed;
+};
+
+struct MonitorRegion {
+    uint32_t magic, version, size, reserved;
+    alignas(64) std::atomic<uint64_t> sequence;
+    alignas(64) StrategySnapshot snapshot;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the sequence is shared between processes");
+
+inline std::string monitor_name(const char* name) {
+    return name[0] == '/' ? name : std::string("/") + name;
+}
+
+class StateMonitor {
+public:
+    // Creates (or takes over) the named region. It is left in place on exit
+    // so the last state can still be inspected.
+    explicit StateMonitor(const char* name) {
+        int fd = shm_open(monitor_name(name).c_str(), O_CREAT | O_RDWR, 0644);
+        if(fd < 0) return;
+        if(ftruncate(fd, sizeof(MonitorRegion)) == 0) {
+            void* p = mmap(nullptr, sizeof(MonitorRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if(p != MAP_FAILED) region = static_cast<MonitorRegion*>(p);
+        }
+        close(fd);
+        if(!region) return;
+        region->magic = 0;
+        region->sequence.store(0, std::memory_order_relaxed);
+        std::memset(&region->snapshot, 0, sizeof(region->snapshot));
+        region->version = MONITOR_VERSION;
+        region->size = sizeof(MonitorRegion);
+        std::atomic_thread_fence(std::memory_order_release);
+        region->magic = MONITOR_MAGIC;
+    }
+
+    ~StateMonitor() {
+        if(region) munmap(region, sizeof(MonitorRegion));
+    }
+
+    StateMonitor(const StateMonitor&) = delete;
+    StateMonitor& operator=(const StateMonitor&) = delete;
+
+    bool ok() const { return region != nullptr; }
+
+    // Fill the returned snapshot in place, then call commit().
+    StrategySnapshot& begin() {
+        uint64_t s = region->sequence.load(std::memory_order_relaxed);
+        region->sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return region->snapshot;
+    }
+
+    void commit() {
+        region->snapshot.updates++;
+        region->sequence.store(region->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    MonitorRegion* region = nullptr;
+};
+
+class MonitorReader {
+public:
+    explicit MonitorReader(const char* name) {
+        int fd = shm_open(monitor_name(name).c_str(), O_RDONLY, 0);
+        if(fd < 0) return;
+        struct stat st;
+        if(fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(MonitorRegion)) {
+            void* p = mmap(nullptr, sizeof(MonitorRegion), PROT_READ, MAP_SHARED, fd, 0);
+            if(p != MAP_FAILED) region = static_cast<const MonitorRegion*>(p);
+        }
+        close(fd);
+    }
+
+    ~MonitorReader() {
+        if(region) munmap(const_cast<MonitorRegion*>(region), sizeof(MonitorRegion));
+    }
+
+    MonitorReader(const MonitorReader&) = delete;
+    MonitorReader& operator=(const MonitorReader&) = delete;
+
+    bool ok() const {
+        return region && region->magic == MONITOR_MAGIC && region->version == MONITOR_VERSION
+            && region->size == sizeof(MonitorRegion);
+    }
+
+    // False if no consistent copy could be taken in the given number of tries.
+    bool read(StrategySnapshot& out, int tries = 1000) const {
+        for(int i=0;i<tries;i++){
+            uint64_t before = region->sequence.load(std::memory_order_acquire);
+            if(before & 1) continue;
+            std::memcpy(&out, &region->snapshot, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(region->sequence.load(std::memory_order_relaxed) == before) return true;
+        }
+        return false;
+    }
+
+private:
+    const MonitorRegion* region = nullptr;
+};
+
+#endif //CPPREADY_TRADER_GO_MONITOR_H
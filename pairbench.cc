@@ -0,0 +1,172 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Runs the live strategy for 1, 16 and 256 ETF/future pairs at once, every
+// pair fed the market data of a session captured with AUTOTRADER_RECORD, and
+// reports the cost per update. It is the trader itself, over one io_context
+// and one order sink, on a virtual clock that follows the recording. The
+// pairs take each message in a scattered order, as they would from a shared
+// feed, and a stand-in exchange acknowledges every order straight away:
+// inserts fill half (every third one in full), cancels and hedges complete.
+//
+// The pairs share one connection's message budget, so the more there are the
+// fewer messages each gets; the table shows how many went out and how many
+// decisions had to wait.
+//
+// Build alongside autotrader.cc against the ready_trader_go library:
+//     pairbench <session file>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include "autotrader.h"
+#include "session.h"
+
+class AckExchange : public OrderSink {
+public:
+    void insert(unsigned long clientOrderId, Side, unsigned long price, unsigned long volume, Lifespan) override {
+        unsigned long filled = ++inserts % 3 == 0 ? volume : volume / 2;
+        if(filled) events.push_back(Event{Event::FILLED, clientOrderId, price, filled, 0});
+        events.push_back(Event{Event::STATUS, clientOrderId, 0, filled, volume - filled});
+    }
+
+    void cancel(unsigned long clientOrderId) override {
+        events.push_back(Event{Event::STATUS, clientOrderId, 0, 0, 0});
+    }
+
+    void hedge(unsigned long clientOrderId, Side, unsigned long price, unsigned long volume) override {
+        events.push_back(Event{Event::HEDGE, clientOrderId, price, volume, 0});
+    }
+
+    // Hands the queued reports to the trader and returns how many there were.
+    template<class Trader>
+    unsigned long deliver(Trader& trader) {
+        // Handlers may send more orders, which can queue more events.
+        size_t i = 0;
+        for(;i<events.size();i++){
+            Event e = events[i];
+            switch(e.type){
+            case Event::FILLED:
+                trader.OrderFilledMessageHandler(e.id, e.price, e.volume);
+                break;
+            case Event::STATUS:
+                trader.OrderStatusMessageHandler(e.id, e.volume, e.remaining, 0);
+                break;
+            case Event::HEDGE:
+                trader.HedgeFilledMessageHandler(e.id, e.price, e.volume);
+                break;
+            }
+        }
+        events.clear();
+        return i;
+    }
+
+private:
+    struct Event {
+        enum Type { FILLED, STATUS, HEDGE } type;
+        unsigned long id, price, volume, remaining;
+    };
+
+    std::vector<Event> events;
+    unsigned long inserts = 0;
+};
+
+template<size_t Pairs>
+static void run(const std::vector<SessionRecord>& session)
+{
+    using Trader = BasicAutoTrader<LivePolicies, Pairs>;
+    boost::asio::io_context context;
+    // Virtual timers do not count as io_context work, so keep it from
+    // stopping once the queue is drained.
+    auto work = boost::asio::make_work_guard(context);
+    VirtualClock clock;
+    // Too big for the stack with many pairs.
+    std::unique_ptr<Trader> trader(new Trader(context, StrategyParams(), &clock, TraderOptions()));
+    AckExchange exchange;
+    trader->set_order_sink(&exchange);
+
+    // Visits the pairs with a stride coprime to their count.
+    size_t stride = Pairs > 1 ? 97 % Pairs : 0;
+    while(stride > 1 && Pairs % stride == 0) stride++;
+    if(Pairs > 1 && stride == 0) stride = 1;
+
+    unsigned long updates = 0;
+    int64_t origin = session.empty() ? 0 : session.front().header.timestamp;
+    auto begin = std::chrono::steady_clock::now();
+    for(const SessionRecord& r: session){
+        clock.advance_to(r.header.timestamp - origin);
+        for(size_t k=0, p=0;k<Pairs;k++, p=(p + stride) % Pairs){
+            if(r.type() == RecordType::ORDER_BOOK)
+                trader->order_book(p, r.instrument(), r.header.sequence, r.askPrices, r.askVolumes, r.bidPrices, r.bidVolumes);
+            else
+                trader->trade_ticks(p, r.instrument(), r.header.sequence, r.askPrices, r.askVolumes, r.bidPrices, r.bidVolumes);
+        }
+        updates += Pairs;
+        context.poll();
+        updates += exchange.deliver(*trader);
+        context.poll();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    unsigned long sent = 0, waited = 0;
+    for(size_t c=0;c<size_t(Priority::COUNT);c++){
+        sent += trader->budget(Priority(c)).sent;
+        waited += trader->budget(Priority(c)).denied;
+    }
+    int lo = trader->position_of(0), hi = lo;
+    for(size_t p=1;p<Pairs;p++){
+        lo = std::min(lo, trader->position_of(p));
+        hi = std::max(hi, trader->position_of(p));
+    }
+    std::printf("%5zu %11lu %10.1f %10.2f %9lu %9lu %6d %6d %6d %9d\n", Pairs, updates, ns / updates, updates * 1e3 / ns,
+                sent, waited, lo, hi, trader->hedge_of(0), trader->theo_of(0));
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc != 2){
+        std::fprintf(stderr, "usage: %s <session file>\n", argv[0]);
+        return 1;
+    }
+
+    // Only market data is fed; executions come from the stand-in exchange.
+    std::vector<SessionRecord> session;
+    {
+        SessionReader reader(argv[1]);
+        if(!reader.ok()){
+            std::fprintf(stderr, "could not open %s\n", argv[1]);
+            return 1;
+        }
+        SessionRecord r;
+        while(reader.next(r))
+            if(r.type() == RecordType::ORDER_BOOK || r.type() == RecordType::TRADE_TICKS) session.push_back(r);
+    }
+
+    std::printf("%5s %11s %10s %10s %9s %9s %6s %6s %6s %9s\n", "pairs", "updates", "ns/update", "M/s",
+                "sent", "waited", "pos lo", "pos hi", "hedge0", "theo0");
+    run<1>(session);
+    run<16>(session);
+    run<256>(session);
+    return 0;
+}
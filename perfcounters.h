@@ -0,0 +1,233 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_PERFCOUNTERS_H
+#define CPPREADY_TRADER_GO_PERFCOUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "latency.h"
+#include "spsc.h"
+
+// Hardware counters per callback. A perf_event group is opened on the
+// trading thread and read once as a callback starts and once as it returns;
+// the differences go through an SpscRing to a background thread that writes
+// them to disk for the perfreport tool.
+//
+// Counters the kernel or the machine does not offer (no PMU in a VM, a
+// strict perf_event_paranoid) are left out and marked unavailable, so the
+// mode still works with whatever remains.
+
+enum class PerfCounter : uint8_t { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, CONTEXT_SWITCHES, COUNT };
+
+enum class PerfCallback : uint8_t { ORDER_BOOK, TRADE_TICKS, MARKET_DATA, ORDER_FILLED, ORDER_STATUS, HEDGE_FILLED, TIMER, COUNT };
+
+constexpr size_t PERF_COUNTERS = size_t(PerfCounter::COUNT);
+
+inline const char* perf_counter_name(PerfCounter c) {
+    static const char* names[] = {"cycles", "instructions", "L1d misses", "LLC misses", "branch misses", "ctx switches"};
+    return names[size_t(c)];
+}
+
+inline const char* perf_callback_name(PerfCallback c) {
+    static const char* names[] = {"OrderBook", "TradeTicks", "MarketData", "OrderFilled", "OrderStatus", "HedgeFilled", "Timer"};
+    return names[size_t(c)];
+}
+
+constexpr uint32_t PERF_MAGIC = 0x52544750;   // "RTGP"
+constexpr uint32_t PERF_VERSION = 1;
+
+struct PerfFileHeader {
+    uint32_t magic, version;
+    uint32_t available;            // bit per PerfCounter
+    uint32_t reserved;
+    double ticks_per_ns;
+    uint64_t dropped;              // samples the drain thread fell behind on
+};
+
+struct PerfSample {
+    uint64_t tsc;                  // when the callback started
+    uint64_t ticks;                // how long it ran, in TSC ticks
+    uint8_t callback;
+    uint8_t reserved[7];
+    std::array<uint64_t, PERF_COUNTERS> delta;
+};
+
+class PerfCounterGroup {
+public:
+    PerfCounterGroup() {
+        slot.fill(-1);
+        fds.fill(-1);
+        open(PerfCounter::CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(PerfCounter::INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(PerfCounter::L1D_MISSES, PERF_TYPE_HW_CACHE,
+             PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        open(PerfCounter::LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        open(PerfCounter::BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        open(PerfCounter::CONTEXT_SWITCHES, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+        if(leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    ~PerfCounterGroup() {
+        for(int fd: fds) if(fd >= 0) close(fd);
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    bool ok() const { return leader >= 0; }
+
+    // Bit per PerfCounter that could be opened.
+    uint32_t available() const {
+        uint32_t mask = 0;
+        for(size_t c=0;c<PERF_COUNTERS;c++) if(slot[c] >= 0) mask |= 1u << c;
+        return mask;
+    }
+
+    // Current totals, in PerfCounter order; 0 for the unavailable ones. The
+    // whole group comes back from one read(), so the counters agree with
+    // each other.
+    bool read(std::array<uint64_t, PERF_COUNTERS>& out) const {
+        uint64_t buffer[1 + PERF_COUNTERS];
+        if(::read(leader, buffer, sizeof(uint64_t) * (1 + members)) != ssize_t(sizeof(uint64_t) * (1 + members))) return false;
+        for(size_t c=0;c<PERF_COUNTERS;c++) out[c] = slot[c] >= 0 ? buffer[1 + slot[c]] : 0;
+        return true;
+    }
+
+private:
+    // Counts only the calling thread, on whichever CPU it runs. Context
+    // switches are seen from the kernel side, so they are asked for with
+    // kernel events first and fall back to without.
+    void open(PerfCounter c, uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = leader < 0;
+        attr.exclude_kernel = type != PERF_TYPE_SOFTWARE;
+        attr.exclude_hv = 1;
+        int fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+        if(fd < 0 && !attr.exclude_kernel) {
+            attr.exclude_kernel = 1;
+            fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+        }
+        if(fd < 0) return;
+        if(leader < 0) leader = fd;
+        fds[size_t(c)] = fd;
+        slot[size_t(c)] = members++;
+    }
+
+    int leader = -1;
+    int members = 0;
+    std::array<int, PERF_COUNTERS> fds;
+    std::array<int, PERF_COUNTERS> slot;   // position in the group's read
+};
+
+class CallbackProfiler {
+public:
+    // Must be constructed on the trading thread, which is the one counted.
+    explicit CallbackProfiler(const std::string& path)
+        : file(group.ok() ? std::fopen(path.c_str(), "wb") : nullptr) {
+        if(!file) return;
+        header = PerfFileHeader{PERF_MAGIC, PERF_VERSION, group.available(), 0, tsc_calibrate(), 0};
+        std::fwrite(&header, sizeof(header), 1, file);
+        drainer = std::thread(&CallbackProfiler::drain, this);
+    }
+
+    ~CallbackProfiler() {
+        running.store(false, std::memory_order_release);
+        if(drainer.joinable()) drainer.join();
+        if(!file) return;
+        header.dropped = ring.drops();
+        std::fseek(file, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fclose(file);
+    }
+
+    CallbackProfiler(const CallbackProfiler&) = delete;
+    CallbackProfiler& operator=(const CallbackProfiler&) = delete;
+
+    // False when no counter could be opened or the file could not be.
+    bool ok() const { return file != nullptr; }
+
+    uint32_t available() const { return group.available(); }
+
+    // The drain thread; not joinable unless ok().
+    std::thread& worker() { return drainer; }
+
+    void begin(PerfCallback callback) {
+        current.callback = uint8_t(callback);
+        active = group.read(start);
+        current.tsc = tsc_now();
+    }
+
+    // Closes the callback begin() opened; a second call does nothing.
+    void end() {
+        if(!active) return;
+        active = false;
+        current.ticks = tsc_now() - current.tsc;
+        std::array<uint64_t, PERF_COUNTERS> stop;
+        if(!group.read(stop)) return;
+        for(size_t c=0;c<PERF_COUNTERS;c++) current.delta[c] = stop[c] - start[c];
+        ring.push(current);
+    }
+
+    size_t drops() const { return ring.drops(); }
+
+private:
+    void drain() {
+        std::array<PerfSample, 256> batch;
+        while(true){
+            bool stopping = !running.load(std::memory_order_acquire);
+            size_t n = 0;
+            while(n < batch.size() && ring.pop(batch[n])) n++;
+            if(n) std::fwrite(batch.data(), sizeof(PerfSample), n, file);
+            else if(stopping) break;
+            else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    PerfCounterGroup group;
+    bool active = false;
+    std::array<uint64_t, PERF_COUNTERS> start{};
+    PerfSample current{};
+    SpscRing<PerfSample, 1 << 14> ring;
+
+    std::FILE* file;
+    PerfFileHeader header{};
+    std::atomic<bool> running{true};
+    std::thread drainer;
+};
+
+#endif //CPPREADY_TRADER_GO_PERFCOUNTERS_H
@@ -0,0 +1,95 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Summarises the counters written with AUTOTRADER_PERF=<file>:
+//     perfreport <file>
+// For every callback it prints the distribution of its duration and of each
+// counter, and the instructions per cycle over all its runs.
+
+#include <array>
+#include <cstdio>
+
+#include "latency.h"
+#include "perfcounters.h"
+
+struct CallbackStats {
+    LatencyHistogram ns;
+    std::array<LatencyHistogram, PERF_COUNTERS> counters;
+    std::array<unsigned long long, PERF_COUNTERS> totals{};
+};
+
+static void line(const char* callback, const char* metric, const LatencyHistogram& h)
+{
+    std::printf("%-12s %-14s %10llu %10llu %10llu %10llu %10llu\n", callback, metric,
+                (unsigned long long)h.count(), (unsigned long long)h.percentile(0.5),
+                (unsigned long long)h.percentile(0.99), (unsigned long long)h.percentile(0.999),
+                (unsigned long long)h.max());
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2){
+        std::fprintf(stderr, "usage: %s <counter file>\n", argv[0]);
+        return 1;
+    }
+
+    std::FILE* in = std::fopen(argv[1], "rb");
+    if(!in){
+        std::fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    PerfFileHeader h;
+    if(std::fread(&h, sizeof(h), 1, in) != 1 || h.magic != PERF_MAGIC || h.version != PERF_VERSION){
+        std::fprintf(stderr, "%s is not a counter file\n", argv[1]);
+        std::fclose(in);
+        return 1;
+    }
+
+    // Each histogram is about 15KB, so keep them off the stack.
+    static std::array<CallbackStats, size_t(PerfCallback::COUNT)> stats;
+    PerfSample s;
+    while(std::fread(&s, sizeof(s), 1, in) == 1){
+        if(s.callback >= stats.size()) continue;
+        CallbackStats& c = stats[s.callback];
+        c.ns.record(uint64_t(s.ticks / h.ticks_per_ns));
+        for(size_t k=0;k<PERF_COUNTERS;k++){
+            c.counters[k].record(s.delta[k]);
+            c.totals[k] += s.delta[k];
+        }
+    }
+    std::fclose(in);
+
+    std::printf("%-12s %-14s %10s %10s %10s %10s %10s\n", "callback", "metric", "count", "p50", "p99", "p99.9", "max");
+    for(size_t cb=0;cb<stats.size();cb++){
+        const CallbackStats& c = stats[cb];
+        if(c.ns.count() == 0) continue;
+        const char* name = perf_callback_name(PerfCallback(cb));
+        line(name, "ns", c.ns);
+        for(size_t k=0;k<PERF_COUNTERS;k++)
+            if(h.available >> k & 1) line(name, perf_counter_name(PerfCounter(k)), c.counters[k]);
+        const size_t cycles = size_t(PerfCounter::CYCLES), instructions = size_t(PerfCounter::INSTRUCTIONS);
+        if((h.available >> cycles & 1) && (h.available >> instructions & 1) && c.totals[cycles])
+            std::printf("%-12s %-14s %10.2f\n", name, "IPC", double(c.totals[instructions]) / c.totals[cycles]);
+    }
+
+    for(size_t k=0;k<PERF_COUNTERS;k++)
+        if(!(h.available >> k & 1)) std::printf("unavailable: %s\n", perf_counter_name(PerfCounter(k)));
+    std::printf("dropped samples: %llu\n", (unsigned long long)h.dropped);
+    return 0;
+}
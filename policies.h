@@ -0,0 +1,132 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_POLICIES_H
+#define CPPREADY_TRADER_GO_POLICIES_H
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "conflation.h"
+#include "valuation.h"
+
+// The strategy's decision rules, picked at compile time. AutoTrader is a
+// template over one pricing, one quoting and one hedging policy; each policy
+// is a struct of static functions, so a variant is compiled with its rules
+// inlined into the handlers and nothing is decided at run time.
+//
+// Pricing values the books:
+//     static int future(const BookSnapshot& b)
+//     static void etf(const BookSnapshot& b, unsigned long clamp, int& ask, int& bid)
+// Quoting places the quotes around theo:
+//     static void prices(int theo, int position, int margin, int& ask, int& bid)
+// Hedging picks the future position to hold and the price to hedge at:
+//     static int target(int position, int current, int cap)
+//     static int price(int theo_fut)
+
+// The nearest price on the 100 cent tick grid, halves up. The trader uses it
+// for its own prices too, so every price is rounded the one way.
+inline int round_to_tick(int x) {
+    return ((x + 50) / 100) * 100;
+}
+
+// Level-weighted values of both sides (see valuation.h).
+template<class Valuation>
+struct BookPricing {
+    static int future(const BookSnapshot& b) {
+        return Valuation::value(b.askPrices, b.askVolumes, b.bidPrices, b.bidVolumes).mid();
+    }
+
+    static void etf(const BookSnapshot& b, unsigned long clamp, int& ask, int& bid) {
+        BookValue v = Valuation::value(b.askPrices, b.askVolumes, b.bidPrices, b.bidVolumes, clamp);
+        ask = v.ask();
+        bid = v.bid();
+    }
+};
+
+// What runs live: the five levels weighted from the touch out.
+using WeightedPricing = BookPricing<BookValuation<35, 25, 15, 10, 5>>;
+
+// The touch alone, and its mid for the future.
+using TopOfBookPricing = BookPricing<BookValuation<100>>;
+
+// The touch prices weighted by their own volumes. The ETF is valued at the
+// touch as above.
+struct VolumeWeightedTopPricing {
+    static int future(const BookSnapshot& b) {
+        long long av = b.askVolumes[0], bv = b.bidVolumes[0];
+        long long num = (long long)b.askPrices[0] * av + (long long)b.bidPrices[0] * bv;
+        long long den = av + bv;
+        return int((den ? num : (long long)(b.askPrices[0] + b.bidPrices[0]) / 2) / (den ? den : 1));
+    }
+
+    static void etf(const BookSnapshot& b, unsigned long clamp, int& ask, int& bid) {
+        TopOfBookPricing::etf(b, clamp, ask, bid);
+    }
+};
+
+// What runs live: margin either side of theo, with the side that would
+// flatten the position a tick closer.
+struct SkewedQuoting {
+    static void prices(int theo, int position, int margin, int& ask, int& bid) {
+        ask = round_to_tick(theo + margin) - 100 * (position > 0);
+        bid = round_to_tick(theo - margin) + 100 * (position < 0);
+    }
+};
+
+// Margin either side of theo, whatever the position.
+struct SymmetricQuoting {
+    static void prices(int theo, int, int margin, int& ask, int& bid) {
+        ask = round_to_tick(theo + margin);
+        bid = round_to_tick(theo - margin);
+    }
+};
+
+// What runs live: hedge all of the position, up to the cap, at the future's
+// value.
+struct CappedHedging {
+    static int target(int position, int, int cap) {
+        return std::min(cap, std::max(-cap, -position));
+    }
+
+    static int price(int theo_fut) {
+        return round_to_tick(theo_fut);
+    }
+};
+
+// As CappedHedging, but the hedge is left alone until it is Band lots off
+// target, trading a little risk for fewer hedge messages.
+template<int Band>
+struct BandHedging {
+    static int target(int position, int current, int cap) {
+        int want = CappedHedging::target(position, current, cap);
+        return std::abs(want - current) < Band ? current : want;
+    }
+
+    static int price(int theo_fut) {
+        return CappedHedging::price(theo_fut);
+    }
+};
+
+template<class PricingPolicy, class QuotingPolicy, class HedgingPolicy>
+struct StrategyPolicies {
+    using Pricing = PricingPolicy;
+    using Quoting = QuotingPolicy;
+    using Hedging = HedgingPolicy;
+};
+
+#endif //CPPREADY_TRADER_GO_POLICIES_H
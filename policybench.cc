@@ -0,0 +1,98 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Runs every policy combination compiled into autotrader.cc over the same
+// session, side by side: how it trades against the simulated exchange (see
+// backtest.h) and how long the whole replay takes per market data message,
+// the best of several runs.
+//
+// Build alongside autotrader.cc against the ready_trader_go library:
+//     policybench <session file> [--runs N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "backtest.h"
+
+struct Variant {
+    const char* name;
+    BacktestResult (*run)(const std::vector<SessionRecord>& session, const StrategyParams& params);
+};
+
+static const Variant VARIANTS[] = {
+    {"live", &backtest<BasicAutoTrader<LivePolicies>>},
+    {"top_of_book", &backtest<BasicAutoTrader<TopOfBookPolicies>>},
+    {"volume_weighted_top", &backtest<BasicAutoTrader<VolumeWeightedTopPolicies>>},
+    {"symmetric_quotes", &backtest<BasicAutoTrader<SymmetricPolicies>>},
+    {"band_hedging", &backtest<BasicAutoTrader<BandHedgingPolicies>>},
+};
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2){
+        std::fprintf(stderr, "usage: %s <session file> [--runs N]\n", argv[0]);
+        return 1;
+    }
+
+    int runs = 5;
+    for(int i=2;i<argc;i++){
+        if(std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = std::max(1, std::atoi(argv[++i]));
+        else {
+            std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // Only market data is replayed; executions come from the simulation.
+    std::vector<SessionRecord> session;
+    {
+        SessionReader reader(argv[1]);
+        if(!reader.ok()){
+            std::fprintf(stderr, "could not open %s\n", argv[1]);
+            return 1;
+        }
+        SessionRecord r;
+        while(reader.next(r))
+            if(r.type() == RecordType::ORDER_BOOK || r.type() == RecordType::TRADE_TICKS) session.push_back(r);
+    }
+    if(session.empty()){
+        std::fprintf(stderr, "no market data in %s\n", argv[1]);
+        return 1;
+    }
+
+    StrategyParams params;
+    std::printf("%-22s %10s %14s %10s %10s %8s %10s %8s %8s\n",
+                "policies", "ns/msg", "pnl", "etf_vol", "hedge_vol", "fills", "messages", "position", "probes");
+    for(const Variant& v: VARIANTS){
+        BacktestResult r;
+        double best = 0;
+        for(int k=0;k<runs;k++){
+            auto start = std::chrono::steady_clock::now();
+            r = v.run(session, params);
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if(k == 0 || ns < best) best = ns;
+        }
+        std::printf("%-22s %10.1f %14lld %10lld %10lld %8lld %10lld %8lld %8lld\n", v.name, best / session.size(),
+                    r.pnl, r.etf_volume, r.hedge_volume, r.fills, r.messages, r.position, r.probes);
+    }
+    return 0;
+}
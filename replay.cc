@@ -0,0 +1,218 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Feeds a session captured with AUTOTRADER_RECORD into an AutoTrader as fast
+// as possible and reports throughput and per-callback latency. The orders the
+// trader emits are written one per line to the optional output file, so two
+// builds can be compared with diff. The trader runs on a virtual clock that
+// follows the recorded receive times, so its timers and message limit see the
+// original pacing and the order stream is the same on every run.
+//
+// With --pace the records are instead fed on the real clock at their recorded
+// spacing divided by the speedup, and the io_context is polled between them,
+// so timers fire when they would live and any thread the trader starts runs
+// alongside the handlers. The latencies then show what the handlers pay for
+// sharing the CPU; the order stream depends on timing and is not repeatable.
+//
+// Build alongside autotrader.cc against the ready_trader_go library:
+//     replay <session file> [order stream output] [--pace speedup]
+//
+// Built with -DAUTOTRADER_COUNT_ALLOCATIONS and linked with alloccount.cc it
+// also counts heap allocations per callback, and exits with status 2 if any
+// callback after the first WARMUP records allocated.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include "autotrader.h"
+#include "session.h"
+
+#ifdef AUTOTRADER_COUNT_ALLOCATIONS
+#include "alloccount.h"
+#endif
+
+static constexpr size_t WARMUP = 1000;
+
+class StreamSink : public OrderSink {
+public:
+    explicit StreamSink(std::FILE* out) : out(out) {}
+
+    void insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan lifespan) override {
+        if(out) std::fprintf(out, "insert %lu %s %lu %lu %s\n", clientOrderId, side == Side::BUY ? "BUY" : "SELL",
+                             price, volume, lifespan == Lifespan::GOOD_FOR_DAY ? "GFD" : "FAK");
+    }
+
+    void cancel(unsigned long clientOrderId) override {
+        if(out) std::fprintf(out, "cancel %lu\n", clientOrderId);
+    }
+
+    void hedge(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume) override {
+        if(out) std::fprintf(out, "hedge %lu %s %lu %lu\n", clientOrderId, side == Side::BUY ? "BUY" : "SELL", price, volume);
+    }
+
+private:
+    std::FILE* out;
+};
+
+static void dispatch(AutoTrader& trader, const SessionRecord& r)
+{
+    switch(r.type()){
+    case RecordType::ORDER_BOOK:
+        trader.OrderBookMessageHandler(r.instrument(), r.header.sequence, r.askPrices, r.askVolumes, r.bidPrices, r.bidVolumes);
+        break;
+    case RecordType::TRADE_TICKS:
+        trader.TradeTicksMessageHandler(r.instrument(), r.header.sequence, r.askPrices, r.askVolumes, r.bidPrices, r.bidVolumes);
+        break;
+    case RecordType::ORDER_FILLED:
+        trader.OrderFilledMessageHandler(r.clientOrderId, r.price, r.volume);
+        break;
+    case RecordType::ORDER_STATUS:
+        trader.OrderStatusMessageHandler(r.clientOrderId, r.fillVolume, r.remainingVolume, r.fees);
+        break;
+    case RecordType::HEDGE_FILLED:
+        trader.HedgeFilledMessageHandler(r.clientOrderId, r.price, r.volume);
+        break;
+    }
+}
+
+// Runs whatever the io_context has ready until the real clock reaches due,
+// sleeping through all but the last 200us of the gap.
+static void wait_until(boost::asio::io_context& context, int64_t due)
+{
+    for(int64_t now = session_now(); now < due; now = session_now()){
+        context.poll();
+        if(due - now > 200000) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+static const char* type_name(int type)
+{
+    static const char* names[] = {"?", "OrderBook", "TradeTicks", "OrderFilled", "OrderStatus", "HedgeFilled"};
+    return (type > 0 && type <= 5) ? names[type] : names[0];
+}
+
+int main(int argc, char* argv[])
+{
+    const char* output = nullptr;
+    double pace = 0;
+    bool bad = argc < 2;
+    for(int i=2;i<argc && !bad;i++){
+        if(std::strcmp(argv[i], "--pace") == 0){
+            char* end = nullptr;
+            pace = i + 1 < argc ? std::strtod(argv[++i], &end) : 0;
+            bad = !end || *end || !(pace > 0);
+        } else if(!output) {
+            output = argv[i];
+        } else {
+            bad = true;
+        }
+    }
+    if(bad){
+        std::fprintf(stderr, "usage: %s <session file> [order stream output] [--pace speedup > 0]\n", argv[0]);
+        return 1;
+    }
+
+    SessionReader reader(argv[1]);
+    if(!reader.ok()){
+        std::fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    std::FILE* out = output ? std::fopen(output, "w") : nullptr;
+    StreamSink sink(out);
+
+    // The io_context is polled after every record so the strategy, which runs
+    // from a posted handler, sees each message in its own event loop turn.
+    boost::asio::io_context context;
+    // Virtual timers do not count as io_context work, so keep it from
+    // stopping once the queue is drained.
+    auto work = boost::asio::make_work_guard(context);
+    VirtualClock clock;
+    // Instrumentation comes from the environment as it would live, but the
+    // loop below drives the io_context, so it cannot busy-poll it too.
+    TraderOptions options = TraderOptions::from_environment();
+    options.low_latency.clear();
+    AutoTrader trader(context, StrategyParams(), pace > 0 ? nullptr : &clock, options);
+    trader.set_order_sink(&sink);
+
+    std::vector<int64_t> latency[6];
+#ifdef AUTOTRADER_COUNT_ALLOCATIONS
+    unsigned long allocating[6] = {}, allocations[6] = {};
+#endif
+    size_t seen = 0;
+    SessionRecord r;
+    int64_t origin = -1;
+    int64_t begin = session_now();
+    while(reader.next(r)){
+#ifdef AUTOTRADER_COUNT_ALLOCATIONS
+        AllocationCount before = allocation_count();
+#endif
+        if(origin < 0) origin = r.header.timestamp;
+        if(pace > 0) wait_until(context, begin + int64_t((r.header.timestamp - origin) / pace));
+        else clock.advance_to(r.header.timestamp - origin);
+        int64_t t0 = session_now();
+        dispatch(trader, r);
+        context.poll();
+        int64_t t1 = session_now();
+#ifdef AUTOTRADER_COUNT_ALLOCATIONS
+        AllocationCount after = allocation_count();
+        unsigned long n = (after.news - before.news) + (after.deletes - before.deletes);
+        if(n && seen >= WARMUP){
+            allocating[r.header.type]++;
+            allocations[r.header.type] += n;
+        }
+#endif
+        latency[r.header.type].push_back(t1 - t0);
+        seen++;
+    }
+    int64_t elapsed = session_now() - begin;
+
+    size_t total = 0;
+    std::printf("%-12s %10s %10s %10s %10s %10s\n", "callback", "count", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+    for(int t=1;t<6;t++){
+        auto& l = latency[t];
+        if(l.empty()) continue;
+        total += l.size();
+        std::sort(l.begin(), l.end());
+        std::printf("%-12s %10zu %10lld %10lld %10lld %10lld\n", type_name(t), l.size(), (long long)l[l.size() / 2],
+                    (long long)l[l.size() * 99 / 100], (long long)l[l.size() * 999 / 1000], (long long)l.back());
+    }
+    std::printf("%zu messages in %.3f ms, %.0f messages/s\n", total, elapsed / 1e6,
+                elapsed > 0 ? total * 1e9 / elapsed : 0.0);
+
+    int status = 0;
+#ifdef AUTOTRADER_COUNT_ALLOCATIONS
+    for(int t=1;t<6;t++){
+        if(!allocating[t]) continue;
+        std::printf("%s: %lu callbacks after warm-up made %lu heap calls\n", type_name(t), allocating[t], allocations[t]);
+        status = 2;
+    }
+    if(!status) std::printf("no heap calls after %zu warm-up records\n", std::min(seen, WARMUP));
+#endif
+
+    if(out) std::fclose(out);
+    return status;
+}
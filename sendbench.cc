@@ -0,0 +1,213 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Compares two ways of putting an insert order on the wire:
+//     rebuilt   encode the whole message into a fresh buffer and copy it to
+//               the connection's output buffer, as a generic writer does
+//     template  patch the order's fields into an OrderTemplates slot and
+//               send from there (WireSink)
+// first for the encoding alone, then through a TCP connection on the
+// loopback interface whose far end decodes and checks every message.
+// It then sends the burst one ETF book update can cause (two cancels, two
+// inserts and a hedge) with a write per message and with one gathered write
+// per burst (WireSink's batch mode).
+//     sendbench [orders]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include "wire.h"
+#include "wiresink.h"
+
+using boost::asio::ip::tcp;
+
+static long long now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The order flow: ids count up, prices walk around a level.
+static unsigned long id_of(size_t i) { return 1 + i; }
+static Side side_of(size_t i) { return i & 1 ? Side::BUY : Side::SELL; }
+static unsigned long price_of(size_t i) { return 15000 + (i * 7919 % 64) * 100; }
+static unsigned long volume_of(size_t i) { return 1 + i % 50; }
+
+struct Rebuilt {
+    std::vector<unsigned char> out;
+
+    const unsigned char* insert(size_t i) {
+        unsigned char message[WIRE_MAX_SIZE] = {};
+        size_t size = wire_insert(message, id_of(i), side_of(i), price_of(i), volume_of(i), Lifespan::GOOD_FOR_DAY);
+        out.clear();
+        out.insert(out.end(), message, message + size);
+        return out.data();
+    }
+};
+
+struct Templated {
+    OrderTemplates<> templates;
+
+    const unsigned char* insert(size_t i) {
+        return templates.insert(id_of(i), side_of(i), price_of(i), volume_of(i), Lifespan::GOOD_FOR_DAY);
+    }
+};
+
+template<class Path>
+static double encode_ns(size_t orders, unsigned& check)
+{
+    Path path;
+    long long begin = now_ns();
+    for(size_t i=0;i<orders;i++){
+        const unsigned char* m = path.insert(i);
+        check += m[6] + m[11] + m[15];
+    }
+    return double(now_ns() - begin) / orders;
+}
+
+static bool is_insert(size_t k, const unsigned char* m)
+{
+    return wire_length(m) == WIRE_INSERT_SIZE && wire_type(m) == WireType::INSERT_ORDER
+        && wire_get32(m + 3) == id_of(k) && Side(wire_get8(m + 7)) == side_of(k)
+        && wire_get32(m + 8) == price_of(k) && wire_get32(m + 12) == volume_of(k);
+}
+
+// Message k of the bursts: cancel, cancel, insert, insert, hedge.
+static WireType burst_type(size_t k)
+{
+    static const WireType types[] = {WireType::CANCEL_ORDER, WireType::CANCEL_ORDER, WireType::INSERT_ORDER,
+                                     WireType::INSERT_ORDER, WireType::HEDGE_ORDER};
+    return types[k % 5];
+}
+
+static bool is_burst(size_t k, const unsigned char* m)
+{
+    return wire_type(m) == burst_type(k) && wire_get32(m + 3) == id_of(k);
+}
+
+// Reads messages until count have arrived; false on one check rejects.
+template<class Check>
+static bool receive(tcp::socket& socket, size_t count, Check check)
+{
+    std::vector<unsigned char> buffer(WIRE_MAX_SIZE * 4096);
+    size_t have = 0, seen = 0;
+    boost::system::error_code ec;
+    while(seen < count){
+        have += socket.read_some(boost::asio::buffer(buffer.data() + have, buffer.size() - have), ec);
+        if(ec) return false;
+        size_t at = 0;
+        while(have - at >= WIRE_HEADER_SIZE && have - at >= wire_length(buffer.data() + at)){
+            if(!check(seen++, buffer.data() + at)) return false;
+            at += wire_length(buffer.data() + at);
+        }
+        std::copy(buffer.begin() + at, buffer.begin() + have, buffer.begin());
+        have -= at;
+    }
+    return true;
+}
+
+// Sends count messages and returns ns per message, or a negative number if
+// the far end saw something wrong.
+template<class Check, class Send>
+static double socket_ns(size_t count, Check check, Send send)
+{
+    boost::asio::io_context context;
+    tcp::acceptor acceptor(context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket client(context), server(context);
+    client.connect(acceptor.local_endpoint());
+    acceptor.accept(server);
+    client.set_option(tcp::no_delay(true));
+
+    bool ok = false;
+    std::thread reader([&]{ ok = receive(server, count, check); });
+    long long begin = now_ns();
+    send(context, client, count);
+    double ns = double(now_ns() - begin) / count;
+    reader.join();
+    return ok ? ns : -1;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t orders = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+    if(!orders){
+        std::fprintf(stderr, "usage: %s [orders]\n", argv[0]);
+        return 1;
+    }
+
+    unsigned check = 0;
+    // Warm up both paths, then time them.
+    encode_ns<Rebuilt>(orders / 10, check);
+    encode_ns<Templated>(orders / 10, check);
+    double rebuilt = encode_ns<Rebuilt>(orders, check);
+    double templated = encode_ns<Templated>(orders, check);
+    std::printf("encoding, %zu inserts:    rebuilt %6.2f ns/order, template %6.2f ns/order (check %u)\n",
+                orders, rebuilt, templated, check);
+
+    size_t sends = std::min<size_t>(orders, 200000);
+    double rebuilt_send = socket_ns(sends, is_insert, [](boost::asio::io_context&, tcp::socket& socket, size_t count){
+        Rebuilt path;
+        for(size_t i=0;i<count;i++) boost::asio::write(socket, boost::asio::buffer(path.insert(i), WIRE_INSERT_SIZE));
+    });
+    unsigned long backlogged = 0;
+    double template_send = socket_ns(sends, is_insert, [&](boost::asio::io_context& context, tcp::socket& socket, size_t count){
+        WireSink sink(socket);
+        for(size_t i=0;i<count;i++) sink.insert(id_of(i), side_of(i), price_of(i), volume_of(i), Lifespan::GOOD_FOR_DAY);
+        // Finish whatever had to go through the backlog.
+        context.run();
+        backlogged = sink.backlogged();
+    });
+    if(rebuilt_send < 0 || template_send < 0){
+        std::printf("the receiver saw a malformed or out of order message\n");
+        return 1;
+    }
+    std::printf("over loopback TCP, %zu:  rebuilt %6.0f ns/order, template %6.0f ns/order (%lu through the backlog)\n",
+                sends, rebuilt_send, template_send, backlogged);
+
+    size_t bursts = sends / 5;
+    unsigned long writes[2] = {};
+    double burst_ns[2];
+    for(int batch=0;batch<2;batch++){
+        burst_ns[batch] = 5 * socket_ns(bursts * 5, is_burst, [&](boost::asio::io_context& context, tcp::socket& socket, size_t count){
+            WireSink sink(socket, batch);
+            for(size_t k=0;k<count;k++){
+                if(burst_type(k) == WireType::CANCEL_ORDER) sink.cancel(id_of(k));
+                else if(burst_type(k) == WireType::INSERT_ORDER) sink.insert(id_of(k), side_of(k), price_of(k), volume_of(k), Lifespan::GOOD_FOR_DAY);
+                else sink.hedge(id_of(k), side_of(k), price_of(k), volume_of(k));
+                if(k % 5 == 4) sink.flush();
+            }
+            context.run();
+            writes[batch] = sink.writes();
+        });
+        if(burst_ns[batch] < 0){
+            std::printf("the receiver saw a malformed or out of order burst\n");
+            return 1;
+        }
+    }
+    std::printf("bursts of 5, %zu:          per message %6.0f ns/burst (%lu writes), batched %6.0f ns/burst (%lu writes)\n",
+                bursts, burst_ns[0], writes[0], burst_ns[1], writes[1]);
+    return 0;
+}
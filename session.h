@@ -0,0 +1,192 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_SESSION_H
+#define CPPREADY_TRADER_GO_SESSION_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include <ready_trader_go/types.h>
+
+// Binary capture of every inbound callback, so a session can be replayed
+// into an AutoTrader without the exchange.
+//
+// The file is a flat sequence of records. Each record is a RecordHeader
+// followed by a body whose layout depends on the type. All fields are
+// 32 bits wide, which is the width the exchange uses on the wire.
+
+enum class RecordType : uint8_t {
+    ORDER_BOOK = 1,
+    TRADE_TICKS = 2,
+    ORDER_FILLED = 3,
+    ORDER_STATUS = 4,
+    HEDGE_FILLED = 5,
+};
+
+struct RecordHeader {
+    int64_t timestamp;      // steady_clock nanoseconds at receipt
+    uint8_t type;
+    uint8_t instrument;
+    uint16_t reserved;
+    uint32_t sequence;
+};
+
+struct BookBody {
+    uint32_t askPrices[ReadyTraderGo::TOP_LEVEL_COUNT];
+    uint32_t askVolumes[ReadyTraderGo::TOP_LEVEL_COUNT];
+    uint32_t bidPrices[ReadyTraderGo::TOP_LEVEL_COUNT];
+    uint32_t bidVolumes[ReadyTraderGo::TOP_LEVEL_COUNT];
+};
+
+struct FillBody {
+    uint32_t clientOrderId, price, volume;
+};
+
+struct StatusBody {
+    uint32_t clientOrderId, fillVolume, remainingVolume;
+    int32_t fees;
+};
+
+// One decoded record, as handed back by SessionReader.
+struct SessionRecord {
+    RecordHeader header;
+    std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT> askPrices, askVolumes, bidPrices, bidVolumes;
+    unsigned long clientOrderId, price, volume, fillVolume, remainingVolume;
+    signed long fees;
+
+    RecordType type() const { return RecordType(header.type); }
+    ReadyTraderGo::Instrument instrument() const { return ReadyTraderGo::Instrument(header.instrument); }
+};
+
+inline int64_t session_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class SessionRecorder {
+public:
+    explicit SessionRecorder(const char* path) : file(std::fopen(path, "wb")) {
+        if(file) std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    }
+
+    ~SessionRecorder() {
+        if(file) std::fclose(file);
+    }
+
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    bool ok() const { return file != nullptr; }
+
+    void book(RecordType type, ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+              const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) {
+        BookBody body;
+        for(size_t i=0;i<ReadyTraderGo::TOP_LEVEL_COUNT;i++){
+            body.askPrices[i] = askPrices[i];
+            body.askVolumes[i] = askVolumes[i];
+            body.bidPrices[i] = bidPrices[i];
+            body.bidVolumes[i] = bidVolumes[i];
+        }
+        write(type, uint8_t(instrument), sequenceNumber, body);
+    }
+
+    void fill(RecordType type, unsigned long clientOrderId, unsigned long price, unsigned long volume) {
+        write(type, 0, 0, FillBody{uint32_t(clientOrderId), uint32_t(price), uint32_t(volume)});
+    }
+
+    void status(unsigned long clientOrderId, unsigned long fillVolume, unsigned long remainingVolume, signed long fees) {
+        write(RecordType::ORDER_STATUS, 0, 0,
+              StatusBody{uint32_t(clientOrderId), uint32_t(fillVolume), uint32_t(remainingVolume), int32_t(fees)});
+    }
+
+private:
+    template<class Body>
+    void write(RecordType type, uint8_t instrument, unsigned long sequence, const Body& body) {
+        if(!file) return;
+        RecordHeader header{session_now(), uint8_t(type), instrument, 0, uint32_t(sequence)};
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fwrite(&body, sizeof(body), 1, file);
+    }
+
+    std::FILE* file;
+};
+
+class SessionReader {
+public:
+    explicit SessionReader(const char* path) : file(std::fopen(path, "rb")) {
+        if(file) std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    }
+
+    ~SessionReader() {
+        if(file) std::fclose(file);
+    }
+
+    SessionReader(const SessionReader&) = delete;
+    SessionReader& operator=(const SessionReader&) = delete;
+
+    bool ok() const { return file != nullptr; }
+
+    // Returns false at end of file or on a truncated or unknown record.
+    bool next(SessionRecord& r) {
+        if(!file || std::fread(&r.header, sizeof(r.header), 1, file) != 1) return false;
+
+        switch(r.type()){
+        case RecordType::ORDER_BOOK:
+        case RecordType::TRADE_TICKS: {
+            BookBody body;
+            if(std::fread(&body, sizeof(body), 1, file) != 1) return false;
+            for(size_t i=0;i<ReadyTraderGo::TOP_LEVEL_COUNT;i++){
+                r.askPrices[i] = body.askPrices[i];
+                r.askVolumes[i] = body.askVolumes[i];
+                r.bidPrices[i] = body.bidPrices[i];
+                r.bidVolumes[i] = body.bidVolumes[i];
+            }
+            return true;
+        }
+        case RecordType::ORDER_FILLED:
+        case RecordType::HEDGE_FILLED: {
+            FillBody body;
+            if(std::fread(&body, sizeof(body), 1, file) != 1) return false;
+            r.clientOrderId = body.clientOrderId;
+            r.price = body.price;
+            r.volume = body.volume;
+            return true;
+        }
+        case RecordType::ORDER_STATUS: {
+            StatusBody body;
+            if(std::fread(&body, sizeof(body), 1, file) != 1) return false;
+            r.clientOrderId = body.clientOrderId;
+            r.fillVolume = body.fillVolume;
+            r.remainingVolume = body.remainingVolume;
+            r.fees = body.fees;
+            return true;
+        }
+        }
+        return false;
+    }
+
+private:
+    std::FILE* file;
+};
+
+#endif //CPPREADY_TRADER_GO_SESSION_H
@@ -0,0 +1,240 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Backtests a grid of StrategyParams over a session captured with
+// AUTOTRADER_RECORD. Every parameter set gets its own AutoTrader and a
+// simulated exchange that fills its quotes against the recorded ETF trade
+// ticks and its hedges against the recorded future book. The runs are spread
+// over all cores by a work-stealing pool. Each run keeps its own virtual
+// clock driven by the recorded receive times, so timeouts and the message
+// limit behave as they did live and the results do not depend on load.
+//
+// Build alongside autotrader.cc against the ready_trader_go library:
+//     sweep <session file> [--threads N] [name=lo:hi:step | name=a,b,c ...]
+// where name is one of the StrategyParams fields, e.g.
+//     sweep session.bin margin=180:300:20 tick_volume=150,200,250
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backtest.h"
+
+// Runs f(0) .. f(n-1) on a fixed set of threads. Tasks are dealt round-robin
+// into per-thread deques; a thread works from the back of its own deque and,
+// once that is empty, steals from the front of the others.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads) : queues(threads ? threads : 1) {}
+
+    template<class F>
+    void run(size_t n, F f) {
+        for(size_t i=0;i<n;i++) queues[i % queues.size()].tasks.push_back(i);
+
+        std::vector<std::thread> workers;
+        for(size_t w=0;w<queues.size();w++){
+            workers.emplace_back([this, w, &f]{
+                size_t task;
+                while(take(w, task)) f(task);
+            });
+        }
+        for(auto& t: workers) t.join();
+    }
+
+private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<size_t> tasks;
+    };
+
+    bool take(size_t w, size_t& task) {
+        {
+            Queue& own = queues[w];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if(!own.tasks.empty()){
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for(size_t k=1;k<queues.size();k++){
+            Queue& victim = queues[(w + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if(!victim.tasks.empty()){
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues;
+};
+
+struct ParamField {
+    const char* name;
+    int StrategyParams::* field;
+    int lo, hi;                 // the values the trader can run with
+};
+
+static const ParamField FIELDS[] = {
+    {"margin", &StrategyParams::margin, 0, 100000},
+    {"etf_clamp", &StrategyParams::etf_clamp, 1, 1000000},
+    {"tick_volume", &StrategyParams::tick_volume, 0, 1000000},
+    {"hedge_cap", &StrategyParams::hedge_cap, 0, 100},
+    {"hedge_fill_offset", &StrategyParams::hedge_fill_offset, 0, 100000},
+    {"speed", &StrategyParams::speed, 1, 1000},
+    {"flow_skew", &StrategyParams::flow_skew, -100000, 100000},
+    {"probe_uncertainty", &StrategyParams::probe_uncertainty, 0, 1000000},
+    {"hedge_on_book", &StrategyParams::hedge_on_book, 0, 1},
+};
+
+struct Axis {
+    const ParamField* field;
+    std::vector<int> values;
+};
+
+// A whole decimal number in [lo, hi], ending at one of the stop characters.
+static bool parse_int(const char*& p, const char* stops, long lo, long hi, int& out)
+{
+    char* end;
+    errno = 0;
+    long v = std::strtol(p, &end, 10);
+    if(end == p || errno || v < lo || v > hi || !std::strchr(stops, *end)) return false;
+    out = int(v);
+    p = end;
+    return true;
+}
+
+// Parses name=lo:hi:step or name=a,b,c, every value in the field's range.
+static bool parse_axis(const char* arg, Axis& axis)
+{
+    const char* eq = std::strchr(arg, '=');
+    if(!eq) return false;
+    std::string name(arg, eq);
+    axis.field = nullptr;
+    for(const auto& f: FIELDS) if(name == f.name) axis.field = &f;
+    if(!axis.field) return false;
+
+    const int flo = axis.field->lo, fhi = axis.field->hi;
+    const char* p = eq + 1;
+    int lo, hi, step;
+    if(std::strchr(p, ':')){
+        if(!parse_int(p, ":", flo, fhi, lo) || !parse_int(++p, ":", flo, fhi, hi) || !parse_int(++p, "", 1, INT_MAX, step))
+            return false;
+        for(long v=lo;v<=hi;v+=step) axis.values.push_back(int(v));
+    } else {
+        for(int v; *p; axis.values.push_back(v)){
+            if(!parse_int(p, ",", flo, fhi, v)) return false;
+            if(*p == ',' && !*++p) return false;
+        }
+    }
+    return !axis.values.empty();
+}
+
+static int usage(const char* argv0)
+{
+    std::fprintf(stderr, "usage: %s <session file> [--threads N] [name=lo:hi:step | name=a,b,c ...]\n", argv0);
+    std::fprintf(stderr, "where N >= 1 and each name takes values in\n");
+    for(const auto& f: FIELDS) std::fprintf(stderr, "    %-18s %d .. %d\n", f.name, f.lo, f.hi);
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2) return usage(argv[0]);
+
+    unsigned threads = std::thread::hardware_concurrency();
+    std::vector<Axis> axes;
+    for(int i=2;i<argc;i++){
+        if(std::strcmp(argv[i], "--threads") == 0){
+            const char* p = i + 1 < argc ? argv[++i] : "";
+            int n;
+            if(!parse_int(p, "", 1, 4096, n)){
+                std::fprintf(stderr, "bad thread count %s\n", p);
+                return usage(argv[0]);
+            }
+            threads = unsigned(n);
+            continue;
+        }
+        Axis axis;
+        if(!parse_axis(argv[i], axis)){
+            std::fprintf(stderr, "bad parameter range %s\n", argv[i]);
+            return usage(argv[0]);
+        }
+        axes.push_back(axis);
+    }
+
+    // Only market data is replayed; executions come from the simulation.
+    std::vector<SessionRecord> session;
+    {
+        SessionReader reader(argv[1]);
+        if(!reader.ok()){
+            std::fprintf(stderr, "could not open %s\n", argv[1]);
+            return 1;
+        }
+        SessionRecord r;
+        while(reader.next(r))
+            if(r.type() == RecordType::ORDER_BOOK || r.type() == RecordType::TRADE_TICKS) session.push_back(r);
+    }
+
+    std::vector<StrategyParams> grid(1);
+    for(const Axis& axis: axes){
+        std::vector<StrategyParams> next;
+        for(const StrategyParams& p: grid){
+            for(int v: axis.values){
+                next.push_back(p);
+                next.back().*(axis.field->field) = v;
+            }
+        }
+        grid.swap(next);
+    }
+
+    std::vector<BacktestResult> results(grid.size());
+    std::atomic<size_t> done{0};
+    WorkStealingPool pool(threads);
+    pool.run(grid.size(), [&](size_t i){
+        results[i] = backtest<AutoTrader>(session, grid[i]);
+        size_t d = ++done;
+        if(d % 100 == 0) std::fprintf(stderr, "%zu / %zu\n", d, grid.size());
+    });
+
+    std::vector<size_t> order(grid.size());
+    for(size_t i=0;i<order.size();i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return results[a].pnl > results[b].pnl; });
+
+    for(const auto& f: FIELDS) std::printf("%-18s", f.name);
+    std::printf("%14s %10s %10s %8s %10s %8s %8s %8s\n", "pnl", "etf_vol", "hedge_vol", "fills", "messages", "position", "probes", "fixed");
+    for(size_t i: order){
+        for(const auto& f: FIELDS) std::printf("%-18d", grid[i].*(f.field));
+        const BacktestResult& r = results[i];
+        std::printf("%14lld %10lld %10lld %8lld %10lld %8lld %8lld %8lld\n", r.pnl, r.etf_volume, r.hedge_volume, r.fills, r.messages,
+                    r.position, r.probes, r.fixed_probes);
+    }
+    return 0;
+}
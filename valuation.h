@@ -0,0 +1,74 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_VALUATION_H
+#define CPPREADY_TRADER_GO_VALUATION_H
+
+#include <array>
+#include <limits>
+
+#include <ready_trader_go/types.h>
+
+// Weighted volume-weighted prices of both sides of a book, kept as exact
+// integer fractions so every build rounds the same way.
+struct BookValue {
+    // A side with less than one lot of weighted volume is worth 0.
+    static constexpr long long MIN_DEN = 100;
+
+    long long askNum, askDen, bidNum, bidDen;
+
+    int ask() const { return askDen < MIN_DEN ? 0 : int(askNum / askDen); }
+    int bid() const { return bidDen < MIN_DEN ? 0 : int(bidNum / bidDen); }
+
+    // Truncated average of the two side values.
+    int mid() const {
+        bool a = askDen >= MIN_DEN, b = bidDen >= MIN_DEN;
+        __int128 ad = a ? askDen : 1, bd = b ? bidDen : 1;
+        __int128 num = (a ? askNum * bd : 0) + (b ? bidNum * ad : 0);
+        return int(num / (2 * ad * bd));
+    }
+};
+
+constexpr unsigned long NO_CLAMP = std::numeric_limits<unsigned long>::max();
+
+// Level weights are given in hundredths, best level first. Volumes are
+// clamped to clamp before weighting.
+template<int... Weights>
+struct BookValuation {
+    static constexpr size_t LEVELS = sizeof...(Weights);
+    static constexpr long long W[LEVELS] = {Weights...};
+    static_assert(LEVELS <= ReadyTraderGo::TOP_LEVEL_COUNT, "more weights than book levels");
+
+    static BookValue value(const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+                           const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+                           const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+                           const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes,
+                           unsigned long clamp = NO_CLAMP) {
+        BookValue v{0, 0, 0, 0};
+        for(size_t i=0;i<LEVELS;i++){
+            long long av = W[i] * (long long)(askVolumes[i] < clamp ? askVolumes[i] : clamp);
+            long long bv = W[i] * (long long)(bidVolumes[i] < clamp ? bidVolumes[i] : clamp);
+            v.askNum += av * (long long)askPrices[i];
+            v.askDen += av;
+            v.bidNum += bv * (long long)bidPrices[i];
+            v.bidDen += bv;
+        }
+        return v;
+    }
+};
+
+#endif //CPPREADY_TRADER_GO_VALUATION_H
@@ -0,0 +1,169 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+
+// Values random books with BookValuation and with the double calc_vwap it
+// replaced, the way the order book handler used both: the future at the
+// truncated mean of its two sides, and each ETF side truncated on its own
+// after clamping volumes to 250. The books are as the exchange sends them:
+// prices on the tick grid, empty levels at the back, and some runs where
+// every level has the same price so the answer is a whole number of cents.
+//
+// Every rounded price must be the same, except where the double's own
+// rounding error decided the result, which are counted and printed:
+// - the exact value is a whole number, and the double landed just below it,
+//   so truncation dropped a cent;
+// - a side holds exactly one lot of weighted volume, and the double summed
+//   it to just under the one lot calc_vwap needed to value the side.
+//
+// It then times both on the future's mid, over the same books.
+//
+//     valuationcheck [books] [seed]
+// Exits with status 1 if any other price differs.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "valuation.h"
+
+using Levels = std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>;
+using LiveValuation = BookValuation<35, 25, 15, 10, 5>;
+
+// As it was in autotrader.cc.
+static double weight[5] = {0.35,0.25,0.15,0.10,0.05};
+static double calc_vwap(const Levels Prices, const Levels Volumes)
+{
+    double A = 0, B = 0;
+    for(int i=0;i<5;i++){
+        A += weight[i]*Prices[i]*Volumes[i];
+        B += weight[i]*Volumes[i];
+    }
+    if(B < 1) return 0;
+    return A/B;
+}
+
+static void clamp(Levels& volumes, unsigned long c)
+{
+    for(auto& v: volumes) v = std::min<unsigned long>(v, c);
+}
+
+// One side of a book, best price first from touch, moving away by step.
+static void side(std::mt19937& rng, unsigned long touch, long step, bool flat, Levels& prices, Levels& volumes)
+{
+    int levels = rng() % 6;
+    unsigned long p = touch;
+    for(int i=0;i<5;i++){
+        bool shown = i < levels;
+        prices[i] = shown ? p : 0;
+        volumes[i] = shown ? (rng() % 8 == 0 ? rng() % 3 : rng() % 1000) : 0;
+        if(!flat) p += step * long(1 + rng() % 3);
+    }
+}
+
+struct Book {
+    Levels ap, av, bp, bv;
+};
+
+struct Tally {
+    long same = 0, float_rounding = 0, threshold = 0, wrong = 0;
+
+    // exact_num / exact_den is the exact value the double approximated;
+    // at_threshold says a side it used held exactly one weighted lot.
+    void check(const char* what, long book, int ours, int theirs, __int128 exact_num, __int128 exact_den,
+               bool at_threshold) {
+        if(ours == theirs) {
+            same++;
+            return;
+        }
+        bool whole = exact_den != 0 && exact_num % exact_den == 0;
+        if(whole && theirs == ours - 1) {
+            if(float_rounding++ < 3) std::printf("book %ld: %s exactly %d, the double truncated to %d\n", book, what, ours, theirs);
+            return;
+        }
+        if(at_threshold) {
+            if(threshold++ < 3) std::printf("book %ld: %s is %d, calc_vwap gave %d from a side of one lot\n", book, what, ours, theirs);
+            return;
+        }
+        if(wrong++ < 10) std::printf("book %ld: %s is %d, calc_vwap gave %d\n", book, what, ours, theirs);
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    long books = argc > 1 ? std::atol(argv[1]) : 10000000;
+    unsigned seed = argc > 2 ? unsigned(std::atol(argv[2])) : 1;
+    if(books < 1){
+        std::fprintf(stderr, "usage: %s [books >= 1] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    Tally tally;
+    std::vector<Book> timed;
+    for(long k=0;k<books;k++){
+        // Far enough from 0 that the deepest bid stays positive.
+        unsigned long mid = 100 * (20 + rng() % 2000);
+        bool flat = rng() % 16 == 0;
+        Levels ap, av, bp, bv;
+        side(rng, mid + 100 * (rng() % 3), 100, flat, ap, av);
+        side(rng, mid - 100 * (rng() % 3), -100, flat, bp, bv);
+        if(timed.size() < 100000) timed.push_back(Book{ap, av, bp, bv});
+
+        // The future: the truncated mean of the two sides.
+        BookValue f = LiveValuation::value(ap, av, bp, bv);
+        int old_fut = int((calc_vwap(ap, av) + calc_vwap(bp, bv)) / 2);
+        bool a = f.askDen >= BookValue::MIN_DEN, b = f.bidDen >= BookValue::MIN_DEN;
+        __int128 ad = a ? f.askDen : 1, bd = b ? f.bidDen : 1;
+        tally.check("future mid", k, f.mid(), old_fut,
+                    (a ? (__int128)f.askNum * bd : 0) + (b ? (__int128)f.bidNum * ad : 0), 2 * ad * bd,
+                    f.askDen == BookValue::MIN_DEN || f.bidDen == BookValue::MIN_DEN);
+
+        // The ETF: each side on its own, volumes clamped first.
+        BookValue e = LiveValuation::value(ap, av, bp, bv, 250);
+        Levels cav = av, cbv = bv;
+        clamp(cav, 250);
+        clamp(cbv, 250);
+        tally.check("etf ask", k, e.ask(), int(calc_vwap(ap, cav)), e.askNum, e.askDen, e.askDen == BookValue::MIN_DEN);
+        tally.check("etf bid", k, e.bid(), int(calc_vwap(bp, cbv)), e.bidNum, e.bidDen, e.bidDen == BookValue::MIN_DEN);
+    }
+
+    std::printf("%ld books: %ld prices the same, %ld a cent low from double rounding, "
+                "%ld sides of one lot the double left unvalued, %ld different\n",
+                books, tally.same, tally.float_rounding, tally.threshold, tally.wrong);
+
+    // Best of five passes each; the sum keeps the work from being dropped.
+    auto time = [&](auto value){
+        double best = 0;
+        long long sum = 0;
+        for(int pass=0;pass<5;pass++){
+            auto start = std::chrono::steady_clock::now();
+            for(const Book& b: timed) sum += value(b);
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if(pass == 0 || ns < best) best = ns;
+        }
+        return std::make_pair(best / timed.size(), sum);
+    };
+    auto before = time([](const Book& b){ return int((calc_vwap(b.ap, b.av) + calc_vwap(b.bp, b.bv)) / 2); });
+    auto after = time([](const Book& b){ return LiveValuation::value(b.ap, b.av, b.bp, b.bv).mid(); });
+    std::printf("future mid: calc_vwap %.1f ns, BookValuation %.1f ns (checksums %lld %lld)\n",
+                before.first, after.first, before.second, after.second);
+    return tally.wrong ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_WIRE_H
+#define CPPREADY_TRADER_GO_WIRE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <ready_trader_go/types.h>
+
+// The exchange's binary protocol. Every message starts with a three byte
+// header: the total message length including the header (uint16) and the
+// message type (uint8). All integers are big-endian.
+
+enum class WireType : uint8_t {
+    AMEND_ORDER = 1,
+    CANCEL_ORDER = 2,
+    ERROR = 3,
+    HEDGE_FILLED = 4,
+    HEDGE_ORDER = 5,
+    INSERT_ORDER = 6,
+    LOGIN = 7,
+    ORDER_FILLED = 8,
+    ORDER_STATUS = 9,
+    ORDER_BOOK_UPDATE = 10,
+    TRADE_TICKS = 11,
+};
+
+constexpr size_t WIRE_HEADER_SIZE = 3;
+constexpr size_t WIRE_AMEND_SIZE = WIRE_HEADER_SIZE + 8;
+constexpr size_t WIRE_CANCEL_SIZE = WIRE_HEADER_SIZE + 4;
+constexpr size_t WIRE_ERROR_TEXT = 50;
+constexpr size_t WIRE_ERROR_SIZE = WIRE_HEADER_SIZE + 4 + WIRE_ERROR_TEXT;
+constexpr size_t WIRE_HEDGE_FILLED_SIZE = WIRE_HEADER_SIZE + 12;
+constexpr size_t WIRE_HEDGE_ORDER_SIZE = WIRE_HEADER_SIZE + 13;
+constexpr size_t WIRE_INSERT_SIZE = WIRE_HEADER_SIZE + 14;
+constexpr size_t WIRE_LOGIN_FIELD = 20;
+constexpr size_t WIRE_LOGIN_SIZE = WIRE_HEADER_SIZE + 2 * WIRE_LOGIN_FIELD;
+constexpr size_t WIRE_ORDER_FILLED_SIZE = WIRE_HEADER_SIZE + 12;
+constexpr size_t WIRE_ORDER_STATUS_SIZE = WIRE_HEADER_SIZE + 16;
+constexpr size_t WIRE_BOOK_SIZE = WIRE_HEADER_SIZE + 5 + 16 * ReadyTraderGo::TOP_LEVEL_COUNT;
+constexpr size_t WIRE_MAX_SIZE = WIRE_BOOK_SIZE;
+
+inline void wire_put8(unsigned char* p, uint8_t v) { p[0] = v; }
+inline void wire_put16(unsigned char* p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+inline void wire_put32(unsigned char* p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+inline uint8_t wire_get8(const unsigned char* p) { return p[0]; }
+inline uint16_t wire_get16(const unsigned char* p) { return uint16_t(p[0] << 8 | p[1]); }
+inline uint32_t wire_get32(const unsigned char* p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+inline void wire_header(unsigned char* p, size_t size, WireType type) {
+    wire_put16(p, uint16_t(size));
+    wire_put8(p + 2, uint8_t(type));
+}
+
+inline size_t wire_length(const unsigned char* p) { return wire_get16(p); }
+inline WireType wire_type(const unsigned char* p) { return WireType(wire_get8(p + 2)); }
+
+// Encoders write one complete message to out and return its size.
+
+inline size_t wire_amend(unsigned char* out, unsigned long clientOrderId, unsigned long volume) {
+    wire_header(out, WIRE_AMEND_SIZE, WireType::AMEND_ORDER);
+    wire_put32(out + 3, clientOrderId);
+    wire_put32(out + 7, volume);
+    return WIRE_AMEND_SIZE;
+}
+
+// The order messages' fields after the header, shared by the encoders and
+// OrderTemplates.
+inline void wire_cancel_fields(unsigned char* out, unsigned long clientOrderId) {
+    wire_put32(out + 3, clientOrderId);
+}
+
+inline void wire_hedge_order_fields(unsigned char* out, unsigned long clientOrderId, ReadyTraderGo::Side side,
+                                    unsigned long price, unsigned long volume) {
+    wire_put32(out + 3, clientOrderId);
+    wire_put8(out + 7, uint8_t(side));
+    wire_put32(out + 8, price);
+    wire_put32(out + 12, volume);
+}
+
+inline void wire_insert_fields(unsigned char* out, unsigned long clientOrderId, ReadyTraderGo::Side side,
+                               unsigned long price, unsigned long volume, ReadyTraderGo::Lifespan lifespan) {
+    wire_put32(out + 3, clientOrderId);
+    wire_put8(out + 7, uint8_t(side));
+    wire_put32(out + 8, price);
+    wire_put32(out + 12, volume);
+    wire_put8(out + 16, uint8_t(lifespan));
+}
+
+inline size_t wire_cancel(unsigned char* out, unsigned long clientOrderId) {
+    wire_header(out, WIRE_CANCEL_SIZE, WireType::CANCEL_ORDER);
+    wire_cancel_fields(out, clientOrderId);
+    return WIRE_CANCEL_SIZE;
+}
+
+inline size_t wire_error(unsigned char* out, unsigned long clientOrderId, const char* text) {
+    wire_header(out, WIRE_ERROR_SIZE, WireType::ERROR);
+    wire_put32(out + 3, clientOrderId);
+    std::memset(out + 7, 0, WIRE_ERROR_TEXT);
+    std::strncpy(reinterpret_cast<char*>(out + 7), text, WIRE_ERROR_TEXT);
+    return WIRE_ERROR_SIZE;
+}
+
+inline size_t wire_hedge_filled(unsigned char* out, unsigned long clientOrderId, unsigned long price, unsigned long volume) {
+    wire_header(out, WIRE_HEDGE_FILLED_SIZE, WireType::HEDGE_FILLED);
+    wire_put32(out + 3, clientOrderId);
+    wire_put32(out + 7, price);
+    wire_put32(out + 11, volume);
+    return WIRE_HEDGE_FILLED_SIZE;
+}
+
+inline size_t wire_hedge_order(unsigned char* out, unsigned long clientOrderId, ReadyTraderGo::Side side,
+                               unsigned long price, unsigned long volume) {
+    wire_header(out, WIRE_HEDGE_ORDER_SIZE, WireType::HEDGE_ORDER);
+    wire_hedge_order_fields(out, clientOrderId, side, price, volume);
+    return WIRE_HEDGE_ORDER_SIZE;
+}
+
+inline size_t wire_insert(unsigned char* out, unsigned long clientOrderId, ReadyTraderGo::Side side,
+                          unsigned long price, unsigned long volume, ReadyTraderGo::Lifespan lifespan) {
+    wire_header(out, WIRE_INSERT_SIZE, WireType::INSERT_ORDER);
+    wire_insert_fields(out, clientOrderId, side, price, volume, lifespan);
+    return WIRE_INSERT_SIZE;
+}
+
+inline size_t wire_login(unsigned char* out, const char* name, const char* secret) {
+    wire_header(out, WIRE_LOGIN_SIZE, WireType::LOGIN);
+    std::memset(out + 3, 0, 2 * WIRE_LOGIN_FIELD);
+    std::strncpy(reinterpret_cast<char*>(out + 3), name, WIRE_LOGIN_FIELD);
+    std::strncpy(reinterpret_cast<char*>(out + 3 + WIRE_LOGIN_FIELD), secret, WIRE_LOGIN_FIELD);
+    return WIRE_LOGIN_SIZE;
+}
+
+inline size_t wire_order_filled(unsigned char* out, unsigned long clientOrderId, unsigned long price, unsigned long volume) {
+    wire_header(out, WIRE_ORDER_FILLED_SIZE, WireType::ORDER_FILLED);
+    wire_put32(out + 3, clientOrderId);
+    wire_put32(out + 7, price);
+    wire_put32(out + 11, volume);
+    return WIRE_ORDER_FILLED_SIZE;
+}
+
+inline size_t wire_order_status(unsigned char* out, unsigned long clientOrderId, unsigned long fillVolume,
+                                unsigned long remainingVolume, signed long fees) {
+    wire_header(out, WIRE_ORDER_STATUS_SIZE, WireType::ORDER_STATUS);
+    wire_put32(out + 3, clientOrderId);
+    wire_put32(out + 7, fillVolume);
+    wire_put32(out + 11, remainingVolume);
+    wire_put32(out + 15, uint32_t(int32_t(fees)));
+    return WIRE_ORDER_STATUS_SIZE;
+}
+
+// Order book updates and trade ticks share one layout.
+inline size_t wire_book(unsigned char* out, WireType type, ReadyTraderGo::Instrument instrument, unsigned long sequenceNumber,
+                        const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askPrices,
+                        const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& askVolumes,
+                        const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidPrices,
+                        const std::array<unsigned long, ReadyTraderGo::TOP_LEVEL_COUNT>& bidVolumes) {
+    wire_header(out, WIRE_BOOK_SIZE, type);
+    wire_put8(out + 3, uint8_t(instrument));
+    wire_put32(out + 4, sequenceNumber);
+    unsigned char* p = out + 8;
+    for(const auto* a: {&askPrices, &askVolumes, &bidPrices, &bidVolumes})
+        for(unsigned long v: *a) { wire_put32(p, v); p += 4; }
+    return WIRE_BOOK_SIZE;
+}
+
+// Ready-made order messages. Every slot holds a complete message whose
+// header is written once up front, so a send only patches the order's fields
+// and hands out the slot. Slots of a type are reused round robin, so a slot
+// stays as it is for the next Slots - 1 sends of its type. WireSink is done
+// with a slot when its send returns, having written it or copied what the
+// socket did not take, except in batch mode, which holds up to BATCH
+// messages until flush(); Slots has to be larger than that.
+template<size_t Slots = 16>
+class OrderTemplates {
+public:
+    static constexpr size_t SLOTS = Slots;
+
+    OrderTemplates() {
+        for(size_t i=0;i<Slots;i++){
+            wire_header(cancels[i].data(), WIRE_CANCEL_SIZE, WireType::CANCEL_ORDER);
+            wire_header(hedges[i].data(), WIRE_HEDGE_ORDER_SIZE, WireType::HEDGE_ORDER);
+            wire_header(inserts[i].data(), WIRE_INSERT_SIZE, WireType::INSERT_ORDER);
+        }
+    }
+
+    const unsigned char* cancel(unsigned long clientOrderId) {
+        unsigned char* p = cancels[next_cancel++ % Slots].data();
+        wire_cancel_fields(p, clientOrderId);
+        return p;
+    }
+
+    const unsigned char* hedge(unsigned long clientOrderId, ReadyTraderGo::Side side, unsigned long price, unsigned long volume) {
+        unsigned char* p = hedges[next_hedge++ % Slots].data();
+        wire_hedge_order_fields(p, clientOrderId, side, price, volume);
+        return p;
+    }
+
+    const unsigned char* insert(unsigned long clientOrderId, ReadyTraderGo::Side side, unsigned long price,
+                                unsigned long volume, ReadyTraderGo::Lifespan lifespan) {
+        unsigned char* p = inserts[next_insert++ % Slots].data();
+        wire_insert_fields(p, clientOrderId, side, price, volume, lifespan);
+        return p;
+    }
+
+private:
+    std::array<std::array<unsigned char, WIRE_CANCEL_SIZE>, Slots> cancels;
+    std::array<std::array<unsigned char, WIRE_HEDGE_ORDER_SIZE>, Slots> hedges;
+    std::array<std::array<unsigned char, WIRE_INSERT_SIZE>, Slots> inserts;
+    size_t next_cancel = 0, next_hedge = 0, next_insert = 0;
+};
+
+#endif //CPPREADY_TRADER_GO_WIRE_H
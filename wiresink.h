@@ -0,0 +1,150 @@
+// Copyright 2021 Optiver Asia Pacific Pty. Ltd.
+//
+// This file is part of Ready Trader Go.
+//
+//     Ready Trader Go is free software: you can redistribute it and/or
+//     modify it under the terms of the GNU Affero General Public License
+//     as published by the Free Software Foundation, either version 3 of
+//     the License, or (at your option) any later version.
+//
+//     Ready Trader Go is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Affero General Public License for more details.
+//
+//     You should have received a copy of the GNU Affero General Public
+//     License along with Ready Trader Go.  If not, see
+//     <https://www.gnu.org/licenses/>.
+#ifndef CPPREADY_TRADER_GO_WIRESINK_H
+#define CPPREADY_TRADER_GO_WIRESINK_H
+
+#include <array>
+#include <vector>
+
+#include <boost/asio/error.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+
+#include "autotrader.h"
+#include "wire.h"
+
+// Writes the trader's orders straight to an execution socket it does not
+// own, e.g. one opened by a custom launcher, bypassing the per-message
+// encoding in BaseAutoTrader (install it with AutoTrader::set_order_sink).
+// There is no such launcher in this tree: the ready_trader_go launcher owns
+// the execution connection and installs no sink, so the trader it builds
+// sends through BaseAutoTrader. sendbench is what exercises this path.
+// Each message is patched into an OrderTemplates slot and given to the
+// kernel with one non-blocking send from there, without being copied. Only
+// when the socket cannot take all of it is the rest copied to a backlog,
+// which is written asynchronously and which later messages queue behind.
+//
+// In batch mode the messages of one callback are held back (still in their
+// slots) and leave together in a single gathered write when the trader
+// calls flush() at the end of the callback, in the order they were sent, so
+// cancels still reach the exchange ahead of the inserts that follow them.
+class WireSink : public OrderSink {
+public:
+    explicit WireSink(boost::asio::ip::tcp::socket& socket, bool batch = false) : socket(socket), batch(batch) {
+        boost::system::error_code ignored;
+        socket.non_blocking(true, ignored);
+    }
+
+    void insert(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume, Lifespan lifespan) override {
+        send(templates.insert(clientOrderId, side, price, volume, lifespan), WIRE_INSERT_SIZE);
+    }
+
+    void cancel(unsigned long clientOrderId) override {
+        send(templates.cancel(clientOrderId), WIRE_CANCEL_SIZE);
+    }
+
+    void hedge(unsigned long clientOrderId, Side side, unsigned long price, unsigned long volume) override {
+        send(templates.hedge(clientOrderId, side, price, volume), WIRE_HEDGE_ORDER_SIZE);
+    }
+
+    void flush() override {
+        if(!held) return;
+        write(held);
+        held = 0;
+    }
+
+    // The first write error; nothing is sent after one.
+    const boost::system::error_code& error() const { return failed; }
+
+    // Messages that had to go through the backlog.
+    unsigned long backlogged() const { return queued; }
+
+    // Calls into the kernel.
+    unsigned long writes() const { return syscalls; }
+
+private:
+    // At most this many messages wait for flush(), fewer than a template
+    // type has slots, so none of them is overwritten while held.
+    static constexpr size_t BATCH = 8;
+    static_assert(BATCH < OrderTemplates<>::SLOTS, "held messages would be overwritten");
+
+    // The first n held messages, as an asio buffer sequence.
+    struct Held {
+        const boost::asio::const_buffer *first, *last;
+        const boost::asio::const_buffer* begin() const { return first; }
+        const boost::asio::const_buffer* end() const { return last; }
+    };
+
+    void send(const unsigned char* message, size_t size) {
+        if(held == BATCH) flush();
+        buffers[held++] = boost::asio::buffer(message, size);
+        if(!batch) flush();
+    }
+
+    // Writes the first n held messages with one non-blocking gathered write
+    // and queues whatever the socket did not take.
+    void write(size_t n) {
+        if(failed) return;
+        size_t skip = 0;
+        if(!writing) {
+            boost::system::error_code ec;
+            syscalls++;
+            skip = socket.write_some(Held{buffers.data(), buffers.data() + n}, ec);
+            if(ec == boost::asio::error::would_block || ec == boost::asio::error::try_again) ec = boost::system::error_code();
+            if(ec) {
+                failed = ec;
+                return;
+            }
+        }
+        for(size_t i=0;i<n;i++){
+            const unsigned char* p = static_cast<const unsigned char*>(buffers[i].data());
+            size_t size = buffers[i].size();
+            if(skip >= size) {
+                skip -= size;
+                continue;
+            }
+            queued++;
+            out.insert(out.end(), p + skip, p + size);
+            skip = 0;
+        }
+        if(!writing) write_backlog();
+    }
+
+    void write_backlog() {
+        if(out.empty() || failed) { writing = false; return; }
+        writing = true;
+        in_flight.swap(out);
+        out.clear();
+        boost::asio::async_write(socket, boost::asio::buffer(in_flight), [this](const boost::system::error_code& ec, size_t){
+            if(ec) failed = ec;
+            write_backlog();
+        });
+    }
+
+    boost::asio::ip::tcp::socket& socket;
+    OrderTemplates<> templates;
+    bool batch;
+    std::array<boost::asio::const_buffer, BATCH> buffers;
+    size_t held = 0;
+    bool writing = false;
+    std::vector<unsigned char> out, in_flight;
+    boost::system::error_code failed;
+    unsigned long queued = 0, syscalls = 0;
+};
+
+#endif //CPPREADY_TRADER_GO_WIRESINK_H